@@ -0,0 +1,381 @@
+#include "bvh.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+const int MAX_LEAF_SIZE = 4;
+const int SAH_BINS = 12;
+
+int BVH::insert(const AABB& bounds, unsigned int user_data) {
+    int proxy;
+    if (!free_proxies.empty()) {
+        proxy = free_proxies.back();
+        free_proxies.pop_back();
+    }
+    else {
+        proxy = static_cast<int>(proxies.size());
+        proxies.emplace_back();
+    }
+    proxies[proxy].bounds = bounds;
+    proxies[proxy].user_data = user_data;
+    proxies[proxy].leaf = -1;
+    proxies[proxy].alive = true;
+
+    nr_objects++;
+    needs_build = true;
+    return proxy;
+}
+
+void BVH::remove(int proxy) {
+    if (!proxies[proxy].alive)
+        return;
+    proxies[proxy].alive = false;
+    free_proxies.push_back(proxy);
+
+    nr_objects--;
+    needs_build = true;
+}
+
+void BVH::update(int proxy, const AABB& bounds) {
+    proxies[proxy].bounds = bounds;
+    if (!needs_build && proxies[proxy].leaf >= 0)
+        dirty_leaves.push_back(proxies[proxy].leaf);
+}
+
+void BVH::build() {
+    nodes.clear();
+    leaf_proxies.clear();
+    dirty_leaves.clear();
+    needs_build = false;
+
+    std::vector<glm::vec3> centroids(proxies.size());
+    for (int i = 0; i < static_cast<int>(proxies.size()); i++) {
+        if (!proxies[i].alive)
+            continue;
+        leaf_proxies.push_back(i);
+        centroids[i] = proxies[i].bounds.center();
+    }
+    if (leaf_proxies.empty())
+        return;
+
+    nodes.reserve(2 * leaf_proxies.size() / MAX_LEAF_SIZE + 1);
+    buildRecursive(-1, 0, static_cast<int>(leaf_proxies.size()), centroids);
+}
+
+int BVH::buildRecursive(int parent, int first, int count, std::vector<glm::vec3>& centroids) {
+    int index = static_cast<int>(nodes.size());
+    nodes.emplace_back();
+    nodes[index].parent = parent;
+
+    AABB bounds, centroid_bounds;
+    for (int i = first; i < first + count; i++) {
+        bounds.expand(proxies[leaf_proxies[i]].bounds);
+        centroid_bounds.expand(centroids[leaf_proxies[i]]);
+    }
+    nodes[index].bounds = bounds;
+
+    auto makeLeaf = [&]() {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        for (int i = first; i < first + count; i++)
+            proxies[leaf_proxies[i]].leaf = index;
+        return index;
+    };
+
+    if (count <= MAX_LEAF_SIZE)
+        return makeLeaf();
+
+    // Binned SAH over all three axes
+    int best_axis = -1, best_split = 0;
+    float best_cost = count * bounds.surfaceArea();
+    glm::vec3 centroid_size = centroid_bounds.max - centroid_bounds.min;
+    for (int axis = 0; axis < 3; axis++) {
+        if (centroid_size[axis] <= 0.0f)
+            continue;
+
+        AABB bin_bounds[SAH_BINS];
+        int bin_counts[SAH_BINS] = {};
+        float bin_scale = SAH_BINS / centroid_size[axis];
+        for (int i = first; i < first + count; i++) {
+            int proxy = leaf_proxies[i];
+            int bin = std::min(SAH_BINS - 1, static_cast<int>((centroids[proxy][axis] - centroid_bounds.min[axis]) * bin_scale));
+            bin_counts[bin]++;
+            bin_bounds[bin].expand(proxies[proxy].bounds);
+        }
+
+        float right_area[SAH_BINS];
+        int right_count[SAH_BINS];
+        AABB acc;
+        int acc_count = 0;
+        for (int bin = SAH_BINS - 1; bin > 0; bin--) {
+            acc.expand(bin_bounds[bin]);
+            acc_count += bin_counts[bin];
+            right_area[bin] = acc.surfaceArea();
+            right_count[bin] = acc_count;
+        }
+
+        acc = AABB();
+        acc_count = 0;
+        for (int split = 1; split < SAH_BINS; split++) {
+            acc.expand(bin_bounds[split - 1]);
+            acc_count += bin_counts[split - 1];
+            if (acc_count == 0 || right_count[split] == 0)
+                continue;
+            float cost = acc_count * acc.surfaceArea() + right_count[split] * right_area[split];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    int mid;
+    if (best_axis == -1) {
+        // No split beats a leaf, but oversized leaves are still split down the middle
+        if (count <= 2 * MAX_LEAF_SIZE)
+            return makeLeaf();
+        mid = first + count / 2;
+    }
+    else {
+        float bin_scale = SAH_BINS / centroid_size[best_axis];
+        auto* split_point = std::partition(leaf_proxies.data() + first, leaf_proxies.data() + first + count, [&](int proxy) {
+            int bin = std::min(SAH_BINS - 1, static_cast<int>((centroids[proxy][best_axis] - centroid_bounds.min[best_axis]) * bin_scale));
+            return bin < best_split;
+        });
+        mid = static_cast<int>(split_point - leaf_proxies.data());
+    }
+
+    int left = buildRecursive(index, first, mid - first, centroids);
+    int right = buildRecursive(index, mid, first + count - mid, centroids);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    return index;
+}
+
+void BVH::refit() {
+    for (int leaf : dirty_leaves) {
+        Node& node = nodes[leaf];
+        node.bounds = AABB();
+        for (int i = node.first; i < node.first + node.count; i++)
+            node.bounds.expand(proxies[leaf_proxies[i]].bounds);
+
+        // Walk up until an ancestor's bounds stop changing
+        int parent = node.parent;
+        while (parent != -1) {
+            AABB bounds = nodes[nodes[parent].left].bounds;
+            bounds.expand(nodes[nodes[parent].right].bounds);
+            if (bounds.min == nodes[parent].bounds.min && bounds.max == nodes[parent].bounds.max)
+                break;
+            nodes[parent].bounds = bounds;
+            parent = nodes[parent].parent;
+        }
+    }
+    dirty_leaves.clear();
+}
+
+void BVH::prepare() {
+    if (needs_build)
+        build();
+    else if (!dirty_leaves.empty())
+        refit();
+}
+
+void BVH::collect(int node, std::vector<unsigned int>& out) {
+    stack.clear();
+    stack.push_back(node);
+    while (!stack.empty()) {
+        const Node& current = nodes[stack.back()];
+        stack.pop_back();
+        if (current.count > 0) {
+            for (int i = current.first; i < current.first + current.count; i++)
+                out.push_back(proxies[leaf_proxies[i]].user_data);
+        }
+        else {
+            stack.push_back(current.left);
+            stack.push_back(current.right);
+        }
+    }
+}
+
+void BVH::cull(const Frustum& frustum, std::vector<unsigned int>& visible) {
+    prepare();
+    if (nodes.empty())
+        return;
+
+    // Classifies a box against the planes still in mask, returns -1 if outside and clears planes it is fully inside
+    auto classify = [&frustum](const AABB& box, unsigned int& mask) {
+        glm::vec3 center = box.center();
+        glm::vec3 extent = box.extent();
+        for (int p = 0; p < 6; p++) {
+            if (!(mask & (1u << p)))
+                continue;
+            const glm::vec4& plane = frustum.planes[p];
+            float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+            if (distance + radius < 0.0f)
+                return -1;
+            if (distance - radius >= 0.0f)
+                mask &= ~(1u << p);
+        }
+        return 0;
+    };
+
+    cull_stack.clear();
+    cull_stack.emplace_back(0, 0x3Fu);
+    while (!cull_stack.empty()) {
+        auto [index, mask] = cull_stack.back();
+        cull_stack.pop_back();
+
+        const Node& node = nodes[index];
+        if (classify(node.bounds, mask) < 0)
+            continue;
+        if (mask == 0) {
+            collect(index, visible);
+            continue;
+        }
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const Proxy& proxy = proxies[leaf_proxies[i]];
+                unsigned int proxy_mask = mask;
+                if (classify(proxy.bounds, proxy_mask) == 0)
+                    visible.push_back(proxy.user_data);
+            }
+        }
+        else {
+            cull_stack.emplace_back(node.left, mask);
+            cull_stack.emplace_back(node.right, mask);
+        }
+    }
+}
+
+// Slab test, returns the entry distance or -1 on a miss
+static float intersectRay(const AABB& box, const glm::vec3& origin, const glm::vec3& inv_dir, float max_t) {
+    glm::vec3 t0 = (box.min - origin) * inv_dir;
+    glm::vec3 t1 = (box.max - origin) * inv_dir;
+    glm::vec3 t_near = glm::min(t0, t1);
+    glm::vec3 t_far = glm::max(t0, t1);
+    float enter = glm::max(glm::max(t_near.x, t_near.y), glm::max(t_near.z, 0.0f));
+    float exit = glm::min(glm::min(t_far.x, t_far.y), glm::min(t_far.z, max_t));
+    return enter <= exit ? enter : -1.0f;
+}
+
+bool BVH::raycast(const Ray& ray, float max_t, RayHit& hit) {
+    prepare();
+    if (nodes.empty())
+        return false;
+
+    glm::vec3 inv_dir = 1.0f / ray.dir;
+    bool found = false;
+    float best_t = max_t;
+
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        if (intersectRay(node.bounds, ray.origin, inv_dir, best_t) < 0.0f)
+            continue;
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const Proxy& proxy = proxies[leaf_proxies[i]];
+                float t = intersectRay(proxy.bounds, ray.origin, inv_dir, best_t);
+                if (t >= 0.0f && t <= best_t) {
+                    best_t = t;
+                    hit.t = t;
+                    hit.user_data = proxy.user_data;
+                    found = true;
+                }
+            }
+        }
+        else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+    return found;
+}
+
+void BVH::query(const AABB& range, std::vector<unsigned int>& result) {
+    prepare();
+    if (nodes.empty())
+        return;
+
+    auto overlaps = [](const AABB& a, const AABB& b) {
+        return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+    };
+
+    stack.clear();
+    stack.push_back(0);
+    while (!stack.empty()) {
+        const Node& node = nodes[stack.back()];
+        stack.pop_back();
+        if (!overlaps(node.bounds, range))
+            continue;
+
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                const Proxy& proxy = proxies[leaf_proxies[i]];
+                if (overlaps(proxy.bounds, range))
+                    result.push_back(proxy.user_data);
+            }
+        }
+        else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
+
+std::vector<CullingBenchmark> benchmarkCulling(const std::vector<size_t>& object_counts, int iterations) {
+    std::vector<CullingBenchmark> results;
+    std::mt19937 rng(1337);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+    glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    FrustumCuller culler("Benchmark");
+
+    for (size_t nr_objects : object_counts) {
+        std::vector<AABB> boxes(nr_objects);
+        BVH bvh;
+        for (size_t i = 0; i < nr_objects; i++) {
+            glm::vec3 center(position(rng), position(rng), position(rng));
+            glm::vec3 extent(size(rng));
+            boxes[i] = AABB(center - extent, center + extent);
+            bvh.insert(boxes[i], static_cast<unsigned int>(i));
+        }
+        bvh.build();
+
+        std::vector<unsigned char> visible_flags;
+        std::vector<unsigned int> visible_ids;
+        visible_ids.reserve(nr_objects);
+
+        CullingBenchmark result{ nr_objects, 0.0, 0.0, 0 };
+        for (int i = 0; i < iterations; i++) {
+            // Rotate the camera so both methods see different frusta
+            glm::mat4 proj_view = proj * glm::rotate(view, glm::radians(360.0f * i / iterations), glm::vec3(0.0f, 1.0f, 0.0f));
+            culler.begin(proj_view);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            culler.test(boxes, visible_flags);
+            auto mid = std::chrono::high_resolution_clock::now();
+            visible_ids.clear();
+            bvh.cull(culler.getFrustum(), visible_ids);
+            auto end = std::chrono::high_resolution_clock::now();
+
+            result.brute_force_ms += std::chrono::duration<double, std::milli>(mid - start).count() / iterations;
+            result.bvh_ms += std::chrono::duration<double, std::milli>(end - mid).count() / iterations;
+            result.nr_visible = static_cast<unsigned int>(visible_ids.size());
+        }
+
+        results.push_back(result);
+    }
+    return results;
+}
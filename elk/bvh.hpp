@@ -0,0 +1,89 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <utility>
+#include <vector>
+
+#include "culling.hpp"
+
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 dir;
+};
+
+struct RayHit {
+    unsigned int user_data = 0;
+    float t = 0.0f;
+};
+
+// Bounding volume hierarchy over object bounds. Objects are referenced by proxy ids returned from insert,
+// queries return the user data given at insertion.
+class BVH {
+public:
+    // Inserting or removing objects schedules a full SAH rebuild before the next query
+    int insert(const AABB& bounds, unsigned int user_data);
+    void remove(int proxy);
+
+    // Moving an object only refits its ancestors before the next query, the topology is kept
+    void update(int proxy, const AABB& bounds);
+
+    void build();
+    void refit();
+
+    // Appends user data of objects intersecting the frustum
+    void cull(const Frustum& frustum, std::vector<unsigned int>& visible);
+    bool raycast(const Ray& ray, float max_t, RayHit& hit);
+    void query(const AABB& range, std::vector<unsigned int>& result);
+
+    size_t size() const {
+        return nr_objects;
+    }
+
+    const AABB& getBounds(int proxy) const {
+        return proxies[proxy].bounds;
+    }
+
+private:
+    struct Proxy {
+        AABB bounds;
+        unsigned int user_data = 0;
+        int leaf = -1;
+        bool alive = false;
+    };
+
+    // Leaves reference count > 0 proxies starting at first in leaf_proxies, inner nodes have two children
+    struct Node {
+        AABB bounds;
+        int parent = -1;
+        int left = -1, right = -1;
+        int first = 0, count = 0;
+    };
+
+    std::vector<Proxy> proxies;
+    std::vector<int> free_proxies;
+    std::vector<Node> nodes;
+    std::vector<int> leaf_proxies;
+    std::vector<int> dirty_leaves;
+    std::vector<int> stack;
+    std::vector<std::pair<int, unsigned int>> cull_stack;
+    size_t nr_objects = 0;
+    bool needs_build = false;
+
+    void prepare();
+    int buildRecursive(int parent, int first, int count, std::vector<glm::vec3>& centroids);
+    void collect(int node, std::vector<unsigned int>& out);
+};
+
+struct CullingBenchmark {
+    size_t nr_objects;
+    double brute_force_ms;
+    double bvh_ms;
+    unsigned int nr_visible;
+};
+
+// Times brute force SIMD culling against BVH culling on random boxes for each object count
+std::vector<CullingBenchmark> benchmarkCulling(const std::vector<size_t>& object_counts, int iterations = 50);
+
+#endif // !BVH_H
@@ -82,6 +82,11 @@ public:
     void processMouseMovement(GLFWwindow* window, GLboolean constrain_pitch = true) {
         double xpos, ypos;
         glfwGetCursorPos(window, &xpos, &ypos);
+        processMouseMovement(xpos, ypos, constrain_pitch);
+    }
+
+    // For threads that cannot poll the window themselves
+    void processMouseMovement(double xpos, double ypos, GLboolean constrain_pitch = true) {
         if (refocus) {
             last_x = static_cast<float>(xpos);
             last_y = static_cast<float>(ypos);
@@ -1,5 +1,51 @@
 #include "common.hpp"
 
+static const std::string sampler_names[] = {
+    "material.texture_diffuse1",
+    "material.texture_specular1",
+    "material.texture_normal1"
+};
+
+Material::Material() {
+    for (unsigned int i = 0; i < bindings.size(); i++)
+        bindings[i] = { GL_TEXTURE0 + i, 0 };
+}
+
+Material::Material(const std::vector<Texture>& textures, GLuint fallback) {
+    std::array<GLuint, static_cast<size_t>(TextureSlot::COUNT)> resolved{};
+    // Shaders only sample the first texture of each type
+    for (const Texture& texture : textures) {
+        GLuint& id = resolved[static_cast<size_t>(texture.type)];
+        if (id == 0)
+            id = texture.id;
+    }
+
+    // Missing specular and normal maps fall back to the diffuse texture, missing diffuse to the fallback
+    GLuint& diffuse = resolved[static_cast<size_t>(TextureSlot::DIFFUSE)];
+    if (diffuse == 0)
+        diffuse = fallback;
+    for (GLuint& id : resolved) {
+        if (id == 0)
+            id = diffuse;
+    }
+
+    for (unsigned int i = 0; i < bindings.size(); i++)
+        bindings[i] = { GL_TEXTURE0 + i, resolved[i] };
+}
+
+void Material::bind() const {
+    for (const Binding& binding : bindings) {
+        glActiveTexture(binding.unit);
+        glBindTexture(GL_TEXTURE_2D, binding.texture);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Material::bindSamplers(Shader& shader) {
+    for (unsigned int i = 0; i < static_cast<unsigned int>(TextureSlot::COUNT); i++)
+        shader.setInt(sampler_names[i], i);
+}
+
 #ifdef PHONG
 #include "shader_utils.hpp"
 
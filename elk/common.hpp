@@ -3,7 +3,10 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <array>
+#include <map>
 #include <string>
+#include <vector>
 
 #include "shader.hpp"
 
@@ -13,12 +16,39 @@ struct Vertex {
     glm::vec2 tex_coord;
 };
 
+enum class TextureSlot : unsigned int {
+    DIFFUSE,
+    SPECULAR,
+    NORMAL,
+    COUNT
+};
+
 struct Texture {
     unsigned int id = 0;
-    std::string type;
+    TextureSlot type = TextureSlot::DIFFUSE;
     std::string path;
 };
 
+// Texture bindings resolved once at import. The texture for slot i is always bound to unit i,
+// so sampler uniforms only depend on the slot and are set per program with bindSamplers.
+class Material {
+public:
+    struct Binding {
+        GLenum unit;
+        GLuint texture;
+    };
+
+    std::array<Binding, static_cast<size_t>(TextureSlot::COUNT)> bindings{};
+
+    // Every slot on its own unit with no texture bound
+    Material();
+    Material(const std::vector<Texture>& textures, GLuint fallback);
+
+    void bind() const;
+
+    static void bindSamplers(Shader& shader);
+};
+
 class Light {
 public:
     glm::vec4 ambient;
@@ -35,6 +65,25 @@ public:
 
     virtual void update(Shader& shader) const = 0;
     virtual ~Light() {}
+
+    // Call after modifying any public parameter so programs pick up the change on their next sync
+    void markDirty() {
+        revision++;
+    }
+
+    bool isDirty(const Shader& shader) const {
+        auto synced = synced_revisions.find(shader.ID);
+        return synced == synced_revisions.end() || synced->second != revision;
+    }
+
+    void sync(Shader& shader) {
+        update(shader);
+        synced_revisions[shader.ID] = revision;
+    }
+
+private:
+    unsigned int revision = 0;
+    std::map<GLuint, unsigned int> synced_revisions;
 };
 
 #define PHONG
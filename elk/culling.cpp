@@ -0,0 +1,142 @@
+#include "culling.hpp"
+
+#include <immintrin.h>
+
+void AABB::expand(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::expand(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+bool AABB::valid() const {
+    return min.x <= max.x && min.y <= max.y && min.z <= max.z;
+}
+
+glm::vec3 AABB::center() const {
+    return 0.5f * (min + max);
+}
+
+glm::vec3 AABB::extent() const {
+    return 0.5f * (max - min);
+}
+
+float AABB::surfaceArea() const {
+    if (!valid())
+        return 0.0f;
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+AABB AABB::transform(const glm::mat4& model) const {
+    glm::mat3 abs_basis(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+    glm::vec3 new_center = glm::vec3(model * glm::vec4(center(), 1.0f));
+    glm::vec3 new_extent = abs_basis * extent();
+    return AABB(new_center - new_extent, new_center + new_extent);
+}
+
+BoundingSphere BoundingSphere::transform(const glm::mat4& model) const {
+    float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    return { glm::vec3(model * glm::vec4(center, 1.0f)), radius * scale };
+}
+
+Frustum::Frustum(const glm::mat4& proj_view) {
+    auto row = [&proj_view](int i) {
+        return glm::vec4(proj_view[0][i], proj_view[1][i], proj_view[2][i], proj_view[3][i]);
+    };
+    planes[0] = row(3) + row(0); // left
+    planes[1] = row(3) - row(0); // right
+    planes[2] = row(3) + row(1); // bottom
+    planes[3] = row(3) - row(1); // top
+    planes[4] = row(3) + row(2); // near
+    planes[5] = row(3) - row(2); // far
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::intersects(const AABB& box) const {
+    glm::vec3 center = box.center();
+    glm::vec3 extent = box.extent();
+    for (const glm::vec4& plane : planes) {
+        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+        float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+        if (distance + radius < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+    for (const glm::vec4& plane : planes) {
+        if (glm::dot(glm::vec3(plane), sphere.center) + plane.w < -sphere.radius)
+            return false;
+    }
+    return true;
+}
+
+void FrustumCuller::begin(const glm::mat4& proj_view) {
+    frustum = Frustum(proj_view);
+    stats = CullStats();
+}
+
+bool FrustumCuller::test(const AABB& box) {
+    bool visible = frustum.intersects(box);
+    visible ? stats.visible++ : stats.culled++;
+    return visible;
+}
+
+bool FrustumCuller::test(const BoundingSphere& sphere) {
+    bool visible = frustum.intersects(sphere);
+    visible ? stats.visible++ : stats.culled++;
+    return visible;
+}
+
+unsigned int FrustumCuller::test(const std::vector<AABB>& boxes, std::vector<unsigned char>& visible) {
+    visible.resize(boxes.size());
+    unsigned int nr_visible = 0;
+
+    size_t i = 0;
+    for (; i + 4 <= boxes.size(); i += 4) {
+        glm::vec3 c[4], e[4];
+        for (int k = 0; k < 4; k++) {
+            c[k] = boxes[i + k].center();
+            e[k] = boxes[i + k].extent();
+        }
+        __m128 cx = _mm_setr_ps(c[0].x, c[1].x, c[2].x, c[3].x);
+        __m128 cy = _mm_setr_ps(c[0].y, c[1].y, c[2].y, c[3].y);
+        __m128 cz = _mm_setr_ps(c[0].z, c[1].z, c[2].z, c[3].z);
+        __m128 ex = _mm_setr_ps(e[0].x, e[1].x, e[2].x, e[3].x);
+        __m128 ey = _mm_setr_ps(e[0].y, e[1].y, e[2].y, e[3].y);
+        __m128 ez = _mm_setr_ps(e[0].z, e[1].z, e[2].z, e[3].z);
+
+        __m128 outside = _mm_setzero_ps();
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)), _mm_mul_ps(cy, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w))
+            );
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(glm::abs(plane.x))), _mm_mul_ps(ey, _mm_set1_ps(glm::abs(plane.y)))),
+                _mm_mul_ps(ez, _mm_set1_ps(glm::abs(plane.z)))
+            );
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; k++) {
+            visible[i + k] = !((mask >> k) & 1);
+            nr_visible += visible[i + k];
+        }
+    }
+    for (; i < boxes.size(); i++) {
+        visible[i] = frustum.intersects(boxes[i]);
+        nr_visible += visible[i];
+    }
+
+    stats.visible += nr_visible;
+    stats.culled += static_cast<unsigned int>(boxes.size()) - nr_visible;
+    return nr_visible;
+}
@@ -0,0 +1,87 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+struct AABB {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+    AABB() = default;
+    AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
+
+    void expand(const glm::vec3& point);
+    void expand(const AABB& other);
+
+    bool valid() const;
+    glm::vec3 center() const;
+    glm::vec3 extent() const;
+    float surfaceArea() const;
+
+    // Bounds of the transformed box, not the tightest bounds of the transformed contents
+    AABB transform(const glm::mat4& model) const;
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    BoundingSphere transform(const glm::mat4& model) const;
+};
+
+// Planes point inwards, a point p is inside a plane when dot(plane, vec4(p, 1)) >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& proj_view);
+
+    bool intersects(const AABB& box) const;
+    bool intersects(const BoundingSphere& sphere) const;
+};
+
+struct CullStats {
+    unsigned int visible = 0;
+    unsigned int culled = 0;
+};
+
+// Culling state of a single pass (scene, shadow cascade, reflection...), each pass keeps its own counts
+class FrustumCuller {
+public:
+    const std::string pass_name;
+
+    explicit FrustumCuller(const std::string& pass_name) : pass_name(pass_name) {}
+
+    // Extracts the frustum for this frame and resets the counters
+    void begin(const glm::mat4& proj_view);
+
+    bool test(const AABB& box);
+    bool test(const BoundingSphere& sphere);
+
+    // Tests four boxes at a time, visible[i] is set to 1 if boxes[i] intersects the frustum
+    unsigned int test(const std::vector<AABB>& boxes, std::vector<unsigned char>& visible);
+
+    // Adds results of tests done outside the culler, e.g. by a hierarchy traversal
+    void record(unsigned int nr_visible, unsigned int nr_culled) {
+        stats.visible += nr_visible;
+        stats.culled += nr_culled;
+    }
+
+    const Frustum& getFrustum() const {
+        return frustum;
+    }
+
+    const CullStats& getStats() const {
+        return stats;
+    }
+
+private:
+    Frustum frustum;
+    CullStats stats;
+};
+
+#endif // !CULLING_H
@@ -0,0 +1,189 @@
+#include "deferred.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+
+// vec4s per point light instance: view space position and radius, ambient, diffuse, specular, visibility
+const unsigned int INSTANCE_VEC4S = 5;
+
+GBuffer GBuffer::create(FrameGraph& graph, unsigned int width, unsigned int height) {
+    return {
+        graph.create("G-buffer albedo", { width, height, GL_RGBA8 }),
+        graph.create("G-buffer normal", { width, height, GL_RG16F }),
+        graph.create("G-buffer depth", { width, height, GL_DEPTH24_STENCIL8 })
+    };
+}
+
+DeferredRenderer::DeferredRenderer() :
+    geometry_shader("shaders/phong.vert", "shaders/gbuffer.frag"),
+    fullscreen_shader("shaders/deferred.vert", "shaders/deferred_dir.frag"),
+    point_shader("shaders/deferred_point.vert", "shaders/deferred_point.frag")
+{
+    glGenVertexArrays(1, &empty_vao);
+
+    // Low poly sphere, pushed out so its faces circumscribe the unit sphere
+    const int segments = 12, rings = 8;
+    const float inflate = 1.0f / (glm::cos(glm::pi<float>() / segments) * glm::cos(glm::pi<float>() / (2 * rings)));
+    std::vector<glm::vec3> vertices;
+    std::vector<GLuint> indices;
+    for (int r = 0; r <= rings; r++) {
+        float phi = glm::pi<float>() * r / rings;
+        for (int s = 0; s < segments; s++) {
+            float theta = glm::two_pi<float>() * s / segments;
+            vertices.push_back(inflate * glm::vec3(glm::sin(phi) * glm::cos(theta), glm::cos(phi), glm::sin(phi) * glm::sin(theta)));
+        }
+    }
+    for (int r = 0; r < rings; r++) {
+        for (int s = 0; s < segments; s++) {
+            GLuint a = r * segments + s, b = r * segments + (s + 1) % segments;
+            GLuint c = a + segments, d = b + segments;
+            indices.insert(indices.end(), { a, b, c, b, d, c });
+        }
+    }
+    volume_index_count = static_cast<GLsizei>(indices.size());
+
+    glGenVertexArrays(1, &volume_vao);
+    glGenBuffers(1, &volume_vbo);
+    glGenBuffers(1, &volume_ebo);
+
+    glBindVertexArray(volume_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, volume_vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volume_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+    // The instance attributes point into the stream buffer, set per frame
+    for (GLuint i = 0; i < INSTANCE_VEC4S; i++) {
+        glEnableVertexAttribArray(1 + i);
+        glVertexAttribDivisor(1 + i, 1);
+    }
+    geometry_shader.bindUniformBlock("CameraBlock", CAMERA_BLOCK_BINDING);
+    glBindVertexArray(0);
+}
+
+DeferredRenderer::~DeferredRenderer() {
+    GLuint buffers[] = { volume_vbo, volume_ebo };
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(1, &volume_vao);
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+void DeferredRenderer::writeGBuffer(FrameGraph::Builder& pass, const GBuffer& gbuffer) {
+    pass.write(gbuffer.albedo_spec).write(gbuffer.normal).depthStencil(gbuffer.depth_stencil);
+}
+
+void DeferredRenderer::resolveGBuffer(FrameGraph::Builder& pass, const GBuffer& gbuffer, FrameResource color, FrameResource depth_stencil) {
+    pass.read(gbuffer.albedo_spec).read(gbuffer.normal).read(gbuffer.depth_stencil).write(color).depthStencil(depth_stencil);
+}
+
+void DeferredRenderer::beginGeometry() {
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+    geometry_shader.use();
+}
+
+void DeferredRenderer::resolve(
+    const FrameGraph& graph,
+    const GBuffer& gbuffer,
+    const glm::mat4& proj,
+    const glm::mat4& view,
+    const std::vector<Light*>& lights,
+    const std::vector<PointLight*>& point_lights,
+    StreamBuffer& stream,
+    float shininess
+) {
+    graph.blit(gbuffer.depth_stencil, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+    FrameResource textures[] = { gbuffer.albedo_spec, gbuffer.normal, gbuffer.depth_stencil };
+    for (GLuint i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(textures[i]));
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    GLboolean cull_face = glIsEnabled(GL_CULL_FACE);
+    GLint cull_mode, depth_func;
+    glGetIntegerv(GL_CULL_FACE_MODE, &cull_mode);
+    glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+
+    const TextureDesc& desc = graph.getDesc(gbuffer.albedo_spec);
+    glm::vec2 screen_size(desc.width, desc.height);
+    glm::mat4 inv_proj = glm::inverse(proj);
+
+    // Directional and spot light, sky pixels are left to the skybox
+    glDisable(GL_DEPTH_TEST);
+    glDepthMask(GL_FALSE);
+    glStencilMask(0x00);
+
+    fullscreen_shader.use();
+    fullscreen_shader.setInt("gbuffer.albedo_spec", 0);
+    fullscreen_shader.setInt("gbuffer.normal", 1);
+    fullscreen_shader.setInt("gbuffer.depth", 2);
+    fullscreen_shader.setMat4("inv_proj", inv_proj);
+    fullscreen_shader.setMat4("view", view);
+    updateMaterialShader(fullscreen_shader, lights, shininess);
+
+    glBindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    // Point lights as additive light volumes. Back faces are depth tested against the scene so only pixels with
+    // geometry in front of the volume's far side are shaded, which also works with the camera inside a volume.
+    StreamRange range;
+    if (!point_lights.empty())
+        range = stream.allocate(point_lights.size() * INSTANCE_VEC4S * sizeof(glm::vec4));
+    glm::vec4* instances = static_cast<glm::vec4*>(range.data);
+    for (size_t i = 0; instances && i < point_lights.size(); i++) {
+        const PointLight& light = *point_lights[i];
+        glm::vec3 peak = glm::max(glm::vec3(light.ambient), glm::max(glm::vec3(light.diffuse), glm::vec3(light.specular)));
+        float radius = getLightRadius(light.visibility, std::max(peak.x, std::max(peak.y, peak.z)));
+
+        glm::vec4* instance = &instances[i * INSTANCE_VEC4S];
+        instance[0] = glm::vec4(glm::vec3(view * glm::vec4(glm::vec3(light.pos), 1.0f)), radius);
+        instance[1] = light.ambient;
+        instance[2] = light.diffuse;
+        instance[3] = light.specular;
+        instance[4] = glm::vec4(light.visibility, 0.0f);
+    }
+
+    if (instances) {
+        stream.commit(range);
+        glBindVertexArray(volume_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, stream.getBuffer());
+        for (GLuint i = 0; i < INSTANCE_VEC4S; i++)
+            glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, INSTANCE_VEC4S * sizeof(glm::vec4), (void*)(range.offset + i * sizeof(glm::vec4)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_GEQUAL);
+        glEnable(GL_CULL_FACE);
+        glCullFace(GL_FRONT);
+
+        point_shader.use();
+        point_shader.setInt("gbuffer.albedo_spec", 0);
+        point_shader.setInt("gbuffer.normal", 1);
+        point_shader.setInt("gbuffer.depth", 2);
+        point_shader.setMat4("proj", proj);
+        point_shader.setMat4("inv_proj", inv_proj);
+        point_shader.setVec2("screen_size", screen_size);
+        point_shader.setFloat("material.shininess", shininess);
+
+        glDrawElementsInstanced(GL_TRIANGLES, volume_index_count, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(point_lights.size()));
+
+        glDisable(GL_BLEND);
+        glCullFace(cull_mode);
+        if (!cull_face)
+            glDisable(GL_CULL_FACE);
+    }
+    glBindVertexArray(0);
+
+    glDepthFunc(depth_func);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glStencilMask(0xFF);
+}
@@ -0,0 +1,68 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "common.hpp"
+#include "frame_graph.hpp"
+#include "shader.hpp"
+#include "shader_utils.hpp"
+#include "stream_buffer.hpp"
+
+// G-buffer textures in the frame graph: packed albedo and specular intensity (RGBA8), octahedral view space
+// normals (RG16F) and a sampled depth-stencil texture positions are reconstructed from
+struct GBuffer {
+    FrameResource albedo_spec, normal, depth_stencil;
+
+    static GBuffer create(FrameGraph& graph, unsigned int width, unsigned int height);
+};
+
+// Deferred path: scene geometry is drawn with geometry_shader into the G-buffer, lighting is then resolved into
+// the scene color with a fullscreen pass for the directional and camera-attached spot light and one instanced
+// light volume draw for all point lights.
+class DeferredRenderer {
+public:
+    Shader geometry_shader;
+
+    DeferredRenderer();
+    ~DeferredRenderer();
+
+    // Declares the G-buffer as the attachments of a geometry pass
+    static void writeGBuffer(FrameGraph::Builder& pass, const GBuffer& gbuffer);
+    // Declares what a resolve pass reads and writes
+    static void resolveGBuffer(FrameGraph::Builder& pass, const GBuffer& gbuffer, FrameResource color, FrameResource depth_stencil);
+
+    // Clears the bound G-buffer and prepares geometry_shader for scene draws, the camera block has to be bound
+    void beginGeometry();
+
+    // Lights the G-buffer into the bound scene color and copies the scene depth and stencil along. Point light
+    // instances are written into stream.
+    void resolve(
+        const FrameGraph& graph,
+        const GBuffer& gbuffer,
+        const glm::mat4& proj,
+        const glm::mat4& view,
+        const std::vector<Light*>& lights,
+        const std::vector<PointLight*>& point_lights,
+        StreamBuffer& stream,
+        float shininess = 32.0f
+    );
+
+    // Fullscreen directional and spot light program, e.g. for shadow uniforms
+    Shader& getDirectionalShader() {
+        return fullscreen_shader;
+    }
+
+private:
+    Shader fullscreen_shader;
+    Shader point_shader;
+
+    GLuint empty_vao;
+    GLuint volume_vao, volume_vbo, volume_ebo;
+    GLsizei volume_index_count;
+};
+
+#endif // !DEFERRED_H
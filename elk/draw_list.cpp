@@ -0,0 +1,85 @@
+#include "draw_list.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "job_system.hpp"
+
+void DrawRecorder::draw(Shader& shader, GLuint vao, GLsizei index_count, const Material* material, const glm::mat4& model) {
+    uint64_t sort_key = (static_cast<uint64_t>(shader.ID) << 32) | vao;
+    packets.push_back({ sort_key, &shader, vao, index_count, material, static_cast<uint32_t>(models.size()), thread });
+    models.push_back(model);
+}
+
+DrawList::DrawList() :
+    recorders(JobSystem::get().getThreadCount())
+{
+    for (size_t t = 0; t < recorders.size(); t++)
+        recorders[t].thread = static_cast<uint32_t>(t);
+}
+
+void DrawList::record(unsigned int count, const std::function<void(DrawRecorder&, unsigned int)>& record_item) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Each job records into the buffer of the thread running it, so recorders are never shared
+    JobSystem& jobs = JobSystem::get();
+    size_t batch = parallel ? jobs.getBatchSize(count, sizeof(DrawPacket)) : count;
+    jobs.parallelFor("Draw recording", count, batch, [&](size_t begin, size_t end) {
+        DrawRecorder& recorder = recorders[JobSystem::getThreadIndex()];
+        for (size_t i = begin; i < end; i++)
+            record_item(recorder, static_cast<unsigned int>(i));
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    record_ms += std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void DrawList::submit(FrustumCuller* culler) {
+    merged.clear();
+    for (DrawRecorder& recorder : recorders) {
+        merged.insert(merged.end(), recorder.packets.begin(), recorder.packets.end());
+        if (culler)
+            culler->record(recorder.nr_visible, recorder.nr_culled);
+    }
+    // Stable, so packets with the same state keep their recording order
+    std::stable_sort(merged.begin(), merged.end(), [](const DrawPacket& a, const DrawPacket& b) {
+        return a.sort_key < b.sort_key;
+    });
+
+    stats = DrawListStats();
+    stats.packets = static_cast<unsigned int>(merged.size());
+    stats.record_ms = record_ms;
+    record_ms = 0.0f;
+
+    Shader* shader = nullptr;
+    const Material* material = nullptr;
+    GLuint vao = 0;
+    for (const DrawPacket& packet : merged) {
+        if (packet.shader != shader) {
+            shader = packet.shader;
+            shader->use();
+            if (packet.material)
+                Material::bindSamplers(*shader);
+            stats.program_changes++;
+        }
+        if (packet.material && packet.material != material) {
+            material = packet.material;
+            material->bind();
+            stats.material_changes++;
+        }
+        shader->setMat4("model", recorders[packet.thread].models[packet.model_offset]);
+        if (packet.vao != vao) {
+            vao = packet.vao;
+            glBindVertexArray(vao);
+            stats.vao_changes++;
+        }
+        glDrawElements(GL_TRIANGLES, packet.index_count, GL_UNSIGNED_INT, 0);
+    }
+    glBindVertexArray(0);
+
+    for (DrawRecorder& recorder : recorders) {
+        recorder.packets.clear();
+        recorder.models.clear();
+        recorder.nr_visible = recorder.nr_culled = 0;
+    }
+}
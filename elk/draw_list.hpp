@@ -0,0 +1,82 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "common.hpp"
+#include "culling.hpp"
+#include "shader.hpp"
+
+// Everything the GL thread needs to issue one indexed draw, recorded without touching GL
+struct DrawPacket {
+    // Program in the high bits and VAO in the low ones, so sorted packets share as much state as possible
+    uint64_t sort_key;
+    Shader* shader;
+    GLuint vao;
+    GLsizei index_count;
+    // Null for depth-only draws
+    const Material* material;
+    // Model matrix in the recording thread's buffer
+    uint32_t model_offset;
+    uint32_t thread;
+};
+
+struct DrawListStats {
+    unsigned int packets = 0;
+    unsigned int program_changes = 0;
+    unsigned int material_changes = 0;
+    unsigned int vao_changes = 0;
+    float record_ms = 0.0f;
+};
+
+// Linear per-thread packet and matrix storage, cleared after every submit but never shrunk
+class DrawRecorder {
+public:
+    void draw(Shader& shader, GLuint vao, GLsizei index_count, const Material* material, const glm::mat4& model);
+
+    void countCulled(bool visible) {
+        visible ? nr_visible++ : nr_culled++;
+    }
+
+private:
+    friend class DrawList;
+
+    uint32_t thread = 0;
+    std::vector<DrawPacket> packets;
+    std::vector<glm::mat4> models;
+    unsigned int nr_visible = 0, nr_culled = 0;
+};
+
+// Scene traversal, culling and matrix setup are recorded as jobs into one buffer per job system thread, the GL
+// thread merges them, sorts by program and VAO and replays the packets with redundant binds skipped.
+class DrawList {
+public:
+    bool parallel = true;
+
+    DrawList();
+
+    // Calls record_item for every index in [0, count), contiguous ranges of indices run in the same job
+    void record(unsigned int count, const std::function<void(DrawRecorder&, unsigned int)>& record_item);
+
+    // Issues and clears the recorded packets, the programs' other uniforms have to be set already. Culling results
+    // of the recording are added to culler.
+    void submit(FrustumCuller* culler = nullptr);
+
+    const DrawListStats& getStats() const {
+        return stats;
+    }
+
+private:
+    std::vector<DrawRecorder> recorders;
+    std::vector<DrawPacket> merged;
+    DrawListStats stats;
+    // Recording time since the last submit
+    float record_ms = 0.0f;
+};
+
+#endif // !DRAW_LIST_H
@@ -0,0 +1,53 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+// Picks the render resolution that keeps the measured GPU frame time at target_ms. The frame time is assumed to
+// scale with the pixel count, so the area is corrected by the ratio of target to measured time. The correction is
+// smoothed because the timings lag a few frames behind, and the scale moves in steps so transient render targets
+// are not reallocated every frame.
+class DynamicResolution {
+public:
+    bool enabled = true;
+    float target_ms = 16.0f;
+    float min_scale = 0.5f, max_scale = 1.0f;
+    float step = 0.05f;
+    float smoothing = 0.1f;
+
+    void update(float gpu_ms) {
+        if (!enabled) {
+            scale = smoothed = 1.0f;
+            return;
+        }
+        if (gpu_ms > 0.0f) {
+            float wanted = scale * std::sqrt(target_ms / gpu_ms);
+            smoothed += (std::clamp(wanted, min_scale, max_scale) - smoothed) * smoothing;
+        }
+        smoothed = std::clamp(smoothed, min_scale, max_scale);
+
+        // Only follow the smoothed scale once it is a full step away, which keeps it from flickering between two
+        float stepped = std::round(smoothed / step) * step;
+        if (std::abs(smoothed - scale) >= step || scale < min_scale || scale > max_scale)
+            scale = std::clamp(stepped, min_scale, max_scale);
+    }
+
+    float getScale() const {
+        return scale;
+    }
+
+    // Extra factor for modes that always render below output resolution
+    glm::uvec2 getSize(const glm::uvec2& window_size, float factor = 1.0f) const {
+        glm::vec2 size = glm::round(glm::vec2(window_size) * scale * factor);
+        return glm::max(glm::uvec2(size), glm::uvec2(1));
+    }
+
+private:
+    float scale = 1.0f;
+    float smoothed = 1.0f;
+};
+
+#endif // !DYNAMIC_RESOLUTION_H
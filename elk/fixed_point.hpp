@@ -0,0 +1,154 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// Signed fixed point number with a 32 bit integer part and 384 fraction bits, enough for Mandelbrot coordinates
+// down to pixel sizes around 1e-100. Limbs are stored most significant first, limb 0 is the integer part.
+class FixedPoint {
+public:
+    static const int LIMBS = 13;
+
+    FixedPoint() = default;
+
+    FixedPoint(double value) {
+        negative = value < 0.0;
+        value = std::abs(value);
+        for (int i = 0; i < LIMBS && value > 0.0; i++) {
+            double limb = std::floor(value);
+            limbs[i] = static_cast<uint32_t>(limb);
+            value = (value - limb) * 4294967296.0;
+        }
+        normalize();
+    }
+
+    std::string toString(int digits) const {
+        std::string text = negative ? "-" : "";
+        text += std::to_string(limbs[0]) + ".";
+        FixedPoint fraction = *this;
+        fraction.negative = false;
+        for (int i = 0; i < digits; i++) {
+            fraction.limbs[0] = 0;
+            fraction.multiplySmall(10);
+            text += static_cast<char>('0' + fraction.limbs[0]);
+        }
+        return text;
+    }
+
+    double toDouble() const {
+        double value = 0.0;
+        for (int i = LIMBS - 1; i >= 0; i--)
+            value = value / 4294967296.0 + limbs[i];
+        return negative ? -value : value;
+    }
+
+    FixedPoint operator-() const {
+        FixedPoint result = *this;
+        result.negative = !negative;
+        result.normalize();
+        return result;
+    }
+
+    FixedPoint operator+(const FixedPoint& other) const {
+        if (negative == other.negative) {
+            FixedPoint result = addMagnitudes(*this, other);
+            result.negative = negative;
+            return result;
+        }
+        // Opposite signs subtract the smaller magnitude from the larger one
+        bool smaller = compareMagnitudes(*this, other) < 0;
+        FixedPoint result = smaller ? subtractMagnitudes(other, *this) : subtractMagnitudes(*this, other);
+        result.negative = smaller ? other.negative : negative;
+        result.normalize();
+        return result;
+    }
+
+    FixedPoint operator-(const FixedPoint& other) const {
+        return *this + -other;
+    }
+
+    // Truncated to the fraction bits, the dropped product limbs only carry into the last one
+    FixedPoint operator*(const FixedPoint& other) const {
+        std::array<uint64_t, LIMBS> sums{};
+        for (int i = 0; i < LIMBS; i++) {
+            for (int j = 0; i + j <= LIMBS && j < LIMBS; j++) {
+                uint64_t product = static_cast<uint64_t>(limbs[i]) * other.limbs[j];
+                if (i + j < LIMBS)
+                    sums[i + j] += product & 0xFFFFFFFFu;
+                if (i + j > 0)
+                    sums[i + j - 1] += product >> 32;
+            }
+        }
+
+        FixedPoint result;
+        uint64_t carry = 0;
+        for (int i = LIMBS - 1; i >= 0; i--) {
+            uint64_t sum = sums[i] + carry;
+            result.limbs[i] = static_cast<uint32_t>(sum);
+            carry = sum >> 32;
+        }
+        result.negative = negative != other.negative;
+        result.normalize();
+        return result;
+    }
+
+    bool operator==(const FixedPoint&) const = default;
+
+private:
+    std::array<uint32_t, LIMBS> limbs{};
+    bool negative = false;
+
+    // Zero has no sign, so equal values compare equal
+    void normalize() {
+        bool zero = true;
+        for (uint32_t limb : limbs)
+            zero = zero && limb == 0;
+        if (zero)
+            negative = false;
+    }
+
+    void multiplySmall(uint32_t factor) {
+        uint64_t carry = 0;
+        for (int i = LIMBS - 1; i >= 0; i--) {
+            uint64_t product = static_cast<uint64_t>(limbs[i]) * factor + carry;
+            limbs[i] = static_cast<uint32_t>(product);
+            carry = product >> 32;
+        }
+    }
+
+    static int compareMagnitudes(const FixedPoint& a, const FixedPoint& b) {
+        for (int i = 0; i < LIMBS; i++) {
+            if (a.limbs[i] != b.limbs[i])
+                return a.limbs[i] < b.limbs[i] ? -1 : 1;
+        }
+        return 0;
+    }
+
+    static FixedPoint addMagnitudes(const FixedPoint& a, const FixedPoint& b) {
+        FixedPoint result;
+        uint64_t carry = 0;
+        for (int i = LIMBS - 1; i >= 0; i--) {
+            uint64_t sum = static_cast<uint64_t>(a.limbs[i]) + b.limbs[i] + carry;
+            result.limbs[i] = static_cast<uint32_t>(sum);
+            carry = sum >> 32;
+        }
+        return result;
+    }
+
+    // Requires |a| >= |b|
+    static FixedPoint subtractMagnitudes(const FixedPoint& a, const FixedPoint& b) {
+        FixedPoint result;
+        int64_t borrow = 0;
+        for (int i = LIMBS - 1; i >= 0; i--) {
+            int64_t difference = static_cast<int64_t>(a.limbs[i]) - b.limbs[i] - borrow;
+            borrow = difference < 0;
+            result.limbs[i] = static_cast<uint32_t>(difference + (borrow << 32));
+        }
+        return result;
+    }
+};
+
+#endif // !FIXED_POINT_H
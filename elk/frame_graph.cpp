@@ -0,0 +1,345 @@
+#include "frame_graph.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    struct FormatInfo {
+        GLenum format, type;
+        unsigned int bytes;
+    };
+
+    FormatInfo getFormatInfo(GLenum internal_format) {
+        switch (internal_format) {
+        case GL_RGB8:
+            // Drivers pad three channel formats to four bytes
+            return { GL_RGB, GL_UNSIGNED_BYTE, 4 };
+        case GL_RGBA8:
+            return { GL_RGBA, GL_UNSIGNED_BYTE, 4 };
+        case GL_RG16F:
+            return { GL_RG, GL_FLOAT, 4 };
+        case GL_RGBA16F:
+            return { GL_RGBA, GL_FLOAT, 8 };
+        case GL_R32F:
+            return { GL_RED, GL_FLOAT, 4 };
+        case GL_RG16I:
+            return { GL_RG_INTEGER, GL_SHORT, 4 };
+        case GL_DEPTH24_STENCIL8:
+            return { GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4 };
+        case GL_DEPTH_COMPONENT32F:
+            return { GL_DEPTH_COMPONENT, GL_FLOAT, 4 };
+        default:
+            std::cout << "ERROR::FRAME_GRAPH:: Unsupported texture format " << internal_format << std::endl;
+            return { GL_RGBA, GL_UNSIGNED_BYTE, 4 };
+        }
+    }
+
+    bool isDepthFormat(GLenum internal_format) {
+        return internal_format == GL_DEPTH24_STENCIL8 || internal_format == GL_DEPTH_COMPONENT32F;
+    }
+
+    bool isFilterable(GLenum internal_format) {
+        return !isDepthFormat(internal_format) && internal_format != GL_RG16I;
+    }
+
+    size_t getSize(const TextureDesc& desc) {
+        return static_cast<size_t>(desc.width) * desc.height * getFormatInfo(desc.format).bytes;
+    }
+}
+
+FrameGraph::Builder& FrameGraph::Builder::read(FrameResource resource) {
+    graph.passes[pass].reads.push_back(resource);
+    return *this;
+}
+
+FrameGraph::Builder& FrameGraph::Builder::write(FrameResource resource) {
+    graph.passes[pass].writes.push_back(resource);
+    return *this;
+}
+
+FrameGraph::Builder& FrameGraph::Builder::depthStencil(FrameResource resource, bool write) {
+    graph.passes[pass].depth_stencil = resource;
+    graph.passes[pass].depth_write = write;
+    return *this;
+}
+
+FrameGraph::Builder& FrameGraph::Builder::sideEffect() {
+    graph.passes[pass].side_effect = true;
+    return *this;
+}
+
+FrameGraph::FrameGraph(int max_idle_frames) : max_idle_frames(max_idle_frames) {}
+
+FrameGraph::~FrameGraph() {
+    for (auto& [key, fbo] : fbos)
+        glDeleteFramebuffers(1, &fbo);
+    for (Texture& texture : textures)
+        glDeleteTextures(1, &texture.id);
+}
+
+void FrameGraph::reset() {
+    resources.clear();
+    passes.clear();
+}
+
+FrameResource FrameGraph::create(const std::string& name, const TextureDesc& desc) {
+    resources.push_back({ name, desc });
+    return static_cast<FrameResource>(resources.size() - 1);
+}
+
+FrameResource FrameGraph::importBackbuffer(unsigned int width, unsigned int height) {
+    Resource backbuffer;
+    backbuffer.name = "Backbuffer";
+    backbuffer.desc = { width, height, GL_RGBA8 };
+    backbuffer.imported = true;
+    resources.push_back(backbuffer);
+    return static_cast<FrameResource>(resources.size() - 1);
+}
+
+FrameResource FrameGraph::importTexture(const std::string& name, GLuint texture, const TextureDesc& desc) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    resource.imported = true;
+    resource.external = texture;
+    resources.push_back(resource);
+    return static_cast<FrameResource>(resources.size() - 1);
+}
+
+void FrameGraph::forgetTexture(GLuint texture) {
+    for (auto fbo = fbos.begin(); fbo != fbos.end();) {
+        if (std::find(fbo->first.begin(), fbo->first.end(), texture) != fbo->first.end()) {
+            glDeleteFramebuffers(1, &fbo->second);
+            fbo = fbos.erase(fbo);
+        }
+        else
+            fbo++;
+    }
+}
+
+FrameGraph::Builder FrameGraph::addPass(const std::string& name, Execute execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    passes.push_back(std::move(pass));
+    return Builder(*this, static_cast<int>(passes.size() - 1));
+}
+
+void FrameGraph::compile() {
+    // Walking backwards from the imported outputs, a pass survives if something later needs what it writes
+    std::vector<bool> needed(resources.size());
+    for (size_t r = 0; r < resources.size(); r++)
+        needed[r] = resources[r].imported;
+
+    stats = FrameGraphStats();
+    for (int p = static_cast<int>(passes.size()) - 1; p >= 0; p--) {
+        Pass& pass = passes[p];
+        bool keep = pass.side_effect || (pass.depth_stencil >= 0 && pass.depth_write && needed[pass.depth_stencil]);
+        for (FrameResource resource : pass.writes)
+            keep = keep || needed[resource];
+
+        pass.culled = !keep;
+        if (pass.culled) {
+            stats.culled++;
+            continue;
+        }
+        // Earlier contents of written textures are kept too, passes may blend or test against them
+        for (FrameResource resource : pass.reads)
+            needed[resource] = true;
+        for (FrameResource resource : pass.writes)
+            needed[resource] = true;
+        if (pass.depth_stencil >= 0)
+            needed[pass.depth_stencil] = true;
+    }
+    stats.passes = static_cast<unsigned int>(passes.size());
+
+    for (Resource& resource : resources) {
+        resource.first = resource.last = -1;
+        resource.texture = -1;
+    }
+    for (int p = 0; p < static_cast<int>(passes.size()); p++) {
+        const Pass& pass = passes[p];
+        if (pass.culled)
+            continue;
+        auto touch = [&](FrameResource r) {
+            Resource& resource = resources[r];
+            if (resource.first < 0)
+                resource.first = p;
+            resource.last = p;
+        };
+        std::for_each(pass.reads.begin(), pass.reads.end(), touch);
+        std::for_each(pass.writes.begin(), pass.writes.end(), touch);
+        if (pass.depth_stencil >= 0)
+            touch(pass.depth_stencil);
+    }
+
+    for (const Resource& resource : resources) {
+        if (resource.imported || resource.first < 0)
+            continue;
+        stats.textures++;
+        stats.unaliased_bytes += getSize(resource.desc);
+    }
+}
+
+int FrameGraph::allocate(const TextureDesc& desc) {
+    for (size_t t = 0; t < textures.size(); t++) {
+        if (!textures[t].in_use && textures[t].desc == desc) {
+            textures[t].in_use = true;
+            textures[t].last_frame = frame;
+            return static_cast<int>(t);
+        }
+    }
+
+    FormatInfo info = getFormatInfo(desc.format);
+    GLenum filter = isFilterable(desc.format) ? GL_LINEAR : GL_NEAREST;
+    GLuint id;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, info.format, info.type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    textures.push_back({ desc, id, frame, true });
+    return static_cast<int>(textures.size() - 1);
+}
+
+GLuint FrameGraph::getFramebuffer(const std::vector<GLuint>& key, const std::vector<FrameResource>& colors, FrameResource depth_stencil) const {
+    auto fbo = fbos.find(key);
+    if (fbo != fbos.end())
+        return fbo->second;
+
+    GLuint id;
+    glGenFramebuffers(1, &id);
+    glBindFramebuffer(GL_FRAMEBUFFER, id);
+
+    std::vector<GLenum> draw_buffers;
+    for (size_t i = 0; i < colors.size(); i++) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i), GL_TEXTURE_2D, getTexture(colors[i]), 0);
+        draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i));
+    }
+    if (draw_buffers.empty()) {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    else
+        glDrawBuffers(static_cast<GLsizei>(draw_buffers.size()), draw_buffers.data());
+
+    if (depth_stencil >= 0) {
+        GLenum attachment = getDesc(depth_stencil).format == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, getTexture(depth_stencil), 0);
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Frame graph framebuffer is not complete!" << std::endl;
+
+    fbos.emplace(key, id);
+    return id;
+}
+
+void FrameGraph::bindPass(const Pass& pass) {
+    if (pass.writes.empty() && pass.depth_stencil < 0)
+        return;
+
+    // The backbuffer can't be combined with other attachments
+    for (FrameResource resource : pass.writes) {
+        if (resources[resource].imported && !resources[resource].external) {
+            const TextureDesc& desc = resources[resource].desc;
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glViewport(0, 0, desc.width, desc.height);
+            return;
+        }
+    }
+
+    std::vector<GLuint> key = { pass.depth_stencil >= 0 ? getTexture(pass.depth_stencil) : 0 };
+    for (FrameResource resource : pass.writes)
+        key.push_back(getTexture(resource));
+
+    glBindFramebuffer(GL_FRAMEBUFFER, getFramebuffer(key, pass.writes, pass.depth_stencil));
+    const TextureDesc& desc = resources[pass.writes.empty() ? pass.depth_stencil : pass.writes[0]].desc;
+    glViewport(0, 0, desc.width, desc.height);
+}
+
+void FrameGraph::execute() {
+    for (Texture& texture : textures)
+        texture.in_use = false;
+
+    for (int p = 0; p < static_cast<int>(passes.size()); p++) {
+        const Pass& pass = passes[p];
+        if (pass.culled)
+            continue;
+
+        for (Resource& resource : resources) {
+            if (resource.first == p && !resource.imported)
+                resource.texture = allocate(resource.desc);
+        }
+
+        bindPass(pass);
+        pass.execute(*this);
+
+        // Storage of textures that are done is free for the following passes
+        for (Resource& resource : resources) {
+            if (resource.last == p && resource.texture >= 0)
+                textures[resource.texture].in_use = false;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    evict();
+    frame++;
+}
+
+void FrameGraph::evict() {
+    for (size_t t = 0; t < textures.size();) {
+        if (frame - textures[t].last_frame <= static_cast<unsigned int>(max_idle_frames)) {
+            t++;
+            continue;
+        }
+
+        forgetTexture(textures[t].id);
+        glDeleteTextures(1, &textures[t].id);
+        textures.erase(textures.begin() + t);
+    }
+
+    stats.physical_textures = 0;
+    stats.bytes = stats.pool_bytes = 0;
+    for (const Texture& texture : textures) {
+        stats.pool_bytes += getSize(texture.desc);
+        if (texture.last_frame == frame) {
+            stats.physical_textures++;
+            stats.bytes += getSize(texture.desc);
+        }
+    }
+}
+
+GLuint FrameGraph::getTexture(FrameResource resource) const {
+    if (resources[resource].external)
+        return resources[resource].external;
+    int texture = resources[resource].texture;
+    return texture >= 0 ? textures[texture].id : 0;
+}
+
+const TextureDesc& FrameGraph::getDesc(FrameResource resource) const {
+    return resources[resource].desc;
+}
+
+void FrameGraph::blit(FrameResource source, GLbitfield mask) const {
+    GLint draw_fbo;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_fbo);
+
+    const TextureDesc& desc = getDesc(source);
+    bool depth = isDepthFormat(desc.format);
+    std::vector<GLuint> key = { depth ? getTexture(source) : 0 };
+    if (!depth)
+        key.push_back(getTexture(source));
+    GLuint read_fbo = getFramebuffer(key, depth ? std::vector<FrameResource>() : std::vector<FrameResource>{ source }, depth ? source : -1);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_fbo);
+    glBlitFramebuffer(0, 0, desc.width, desc.height, viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3], mask, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, draw_fbo);
+}
@@ -0,0 +1,131 @@
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+struct TextureDesc {
+    unsigned int width = 0, height = 0;
+    GLenum format = GL_RGBA8;
+
+    bool operator==(const TextureDesc&) const = default;
+};
+
+struct FrameGraphStats {
+    unsigned int passes = 0;
+    unsigned int culled = 0;
+    unsigned int textures = 0;
+    unsigned int physical_textures = 0;
+    size_t bytes = 0;
+    size_t unaliased_bytes = 0;
+    size_t pool_bytes = 0;
+};
+
+// Virtual texture of the current frame
+using FrameResource = int;
+
+// Per-frame render graph. Passes declare the textures they read and write and are only executed if they lead to
+// the backbuffer or have side effects. Transient textures live from their first to their last use and get their
+// storage from a pool, textures whose lifetimes don't overlap share the same storage and framebuffers are cached
+// per attachment set. The graph is rebuilt every frame, so resizing only means declaring textures with the new
+// size, pooled storage nobody asked for in max_idle_frames frames is freed.
+class FrameGraph {
+public:
+    using Execute = std::function<void(FrameGraph&)>;
+
+    class Builder {
+    public:
+        // Sampled in the pass
+        Builder& read(FrameResource resource);
+        // Color attachments in draw buffer order
+        Builder& write(FrameResource resource);
+        // Depth-stencil attachment, optionally only tested against
+        Builder& depthStencil(FrameResource resource, bool write = true);
+        // Keeps the pass even if nothing reads its output
+        Builder& sideEffect();
+
+    private:
+        friend class FrameGraph;
+        FrameGraph& graph;
+        int pass;
+
+        Builder(FrameGraph& graph, int pass) : graph(graph), pass(pass) {}
+    };
+
+    int max_idle_frames;
+
+    FrameGraph(int max_idle_frames = 60);
+    ~FrameGraph();
+
+    // Drops last frame's passes and resources
+    void reset();
+
+    FrameResource create(const std::string& name, const TextureDesc& desc);
+    FrameResource importBackbuffer(unsigned int width, unsigned int height);
+    // Texture owned outside the graph, e.g. kept across frames
+    FrameResource importTexture(const std::string& name, GLuint texture, const TextureDesc& desc);
+    // Drops cached framebuffers of an imported texture, call before its owner deletes it
+    void forgetTexture(GLuint texture);
+    Builder addPass(const std::string& name, Execute execute);
+
+    // Culls passes and computes resource lifetimes
+    void compile();
+    void execute();
+
+    // Storage of a resource, only valid while one of its passes executes
+    GLuint getTexture(FrameResource resource) const;
+    const TextureDesc& getDesc(FrameResource resource) const;
+
+    // Copies a resource read by the current pass into the bound attachments
+    void blit(FrameResource source, GLbitfield mask) const;
+
+    const FrameGraphStats& getStats() const {
+        return stats;
+    }
+
+private:
+    struct Resource {
+        std::string name;
+        TextureDesc desc;
+        bool imported = false;
+        GLuint external = 0;
+        int texture = -1;
+        int first = -1, last = -1;
+    };
+
+    struct Pass {
+        std::string name;
+        Execute execute;
+        std::vector<FrameResource> reads, writes;
+        FrameResource depth_stencil = -1;
+        bool depth_write = false;
+        bool side_effect = false;
+        bool culled = false;
+    };
+
+    struct Texture {
+        TextureDesc desc;
+        GLuint id;
+        unsigned int last_frame;
+        bool in_use;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<Texture> textures;
+    // Keyed by the depth-stencil texture followed by the color textures, 0 for none
+    mutable std::map<std::vector<GLuint>, GLuint> fbos;
+    unsigned int frame = 0;
+    FrameGraphStats stats;
+
+    int allocate(const TextureDesc& desc);
+    GLuint getFramebuffer(const std::vector<GLuint>& key, const std::vector<FrameResource>& colors, FrameResource depth_stencil) const;
+    void bindPass(const Pass& pass);
+    void evict();
+};
+
+#endif // !FRAME_GRAPH_H
@@ -0,0 +1,73 @@
+#ifndef GPU_QUERIES_H
+#define GPU_QUERIES_H
+
+#include <glad/glad.h>
+
+#include <vector>
+
+// GPU query wrapped around a part of the frame (GL_SAMPLES_PASSED, GL_TIME_ELAPSED, ...). Queries rotate through a
+// small ring and results are collected once available, so reading them never stalls the CPU and the result lags
+// the current frame by latency frames or more. The ring grows when the GPU falls further behind than that.
+class GpuCounter {
+public:
+    const GLenum target;
+
+    GpuCounter(GLenum target, int latency = 3) : target(target), queries(latency < 1 ? 1 : latency), pending(queries.size(), false) {
+        glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+    }
+
+    ~GpuCounter() {
+        glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+    }
+
+    void begin() {
+        size_t next = (current + 1) % queries.size();
+        // Collect the slot's old result before it is reused. If the GPU is still behind, a new query is inserted
+        // ahead of the oldest one instead of waiting on it, so the ring keeps its order.
+        if (pending[next]) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[next], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                glGetQueryObjectui64v(queries[next], GL_QUERY_RESULT, &result);
+                pending[next] = false;
+            }
+            else {
+                GLuint query;
+                glGenQueries(1, &query);
+                queries.insert(queries.begin() + next, query);
+                pending.insert(pending.begin() + next, false);
+            }
+        }
+        current = next;
+        glBeginQuery(target, queries[current]);
+    }
+
+    void end() {
+        glEndQuery(target);
+        pending[current] = true;
+    }
+
+    // Latest available result
+    GLuint64 getResult() {
+        for (size_t i = 1; i <= queries.size(); i++) {
+            size_t slot = (current + i) % queries.size();
+            if (!pending[slot])
+                continue;
+            GLuint available = 0;
+            glGetQueryObjectuiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+            glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &result);
+            pending[slot] = false;
+        }
+        return result;
+    }
+
+private:
+    std::vector<GLuint> queries;
+    std::vector<bool> pending;
+    size_t current = 0;
+    GLuint64 result = 0;
+};
+
+#endif // !GPU_QUERIES_H
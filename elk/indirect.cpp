@@ -0,0 +1,323 @@
+#include "indirect.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <format>
+
+#include "culling.hpp"
+#include "shader_utils.hpp"
+
+// SSBO bindings in indirect.vert and indirect_cull.comp
+const GLuint TRANSFORM_BINDING = 0, DRAW_BINDING = 1, MATERIAL_BINDING = 2, MESH_BINDING = 3, COMMAND_BINDING = 4, COUNTER_BINDING = 5;
+// Instanced attribute holding the draw index, read at the command's base instance
+const GLuint DRAW_ID_LOCATION = 3;
+const GLuint CULL_GROUP_SIZE = 64, HIZ_GROUP_SIZE = 8;
+
+IndirectScene::IndirectScene() :
+    fallback_shader("shaders/indirect_fallback.vert", "shaders/indirect.frag")
+{
+    fallback_shader.bindUniformBlock("CameraBlock", CAMERA_BLOCK_BINDING);
+    if (isSupported()) {
+        indirect_shader = std::make_unique<Shader>("shaders/indirect.vert", "shaders/indirect.frag");
+        indirect_shader->bindUniformBlock("CameraBlock", CAMERA_BLOCK_BINDING);
+        cull_shader = std::make_unique<Shader>("shaders/indirect_cull.comp");
+        hiz_shader = std::make_unique<Shader>("shaders/hiz_build.comp");
+    }
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glGenBuffers(1, &draw_id_vbo);
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, pos));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coord));
+    if (isSupported()) {
+        glBindBuffer(GL_ARRAY_BUFFER, draw_id_vbo);
+        glEnableVertexAttribArray(DRAW_ID_LOCATION);
+        glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+
+        glGenBuffers(1, &transform_ssbo);
+        glGenBuffers(1, &draw_ssbo);
+        glGenBuffers(1, &material_ssbo);
+        glGenBuffers(1, &mesh_ssbo);
+        glGenBuffers(1, &command_buffer);
+        glGenBuffers(1, &culled_command_buffer);
+
+        GLuint zero = 0;
+        glGenBuffers(1, &counter_buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, counter_buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), &zero, GL_DYNAMIC_COPY);
+        glGenBuffers(READBACK_FRAMES, readback_buffers);
+        for (GLuint buffer : readback_buffers) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, sizeof(GLuint), &zero, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+IndirectScene::~IndirectScene() {
+    GLuint buffers[] = { vbo, ebo, draw_id_vbo, transform_ssbo, draw_ssbo, material_ssbo, mesh_ssbo, command_buffer, culled_command_buffer, counter_buffer };
+    glDeleteBuffers(10, buffers);
+    glDeleteBuffers(READBACK_FRAMES, readback_buffers);
+    glDeleteTextures(1, &hiz_texture);
+    glDeleteVertexArrays(1, &vao);
+}
+
+unsigned int IndirectScene::addMesh(const std::vector<Vertex>& mesh_vertices, const std::vector<unsigned int>& mesh_indices) {
+    AABB bounds;
+    for (const Vertex& vertex : mesh_vertices)
+        bounds.expand(vertex.pos);
+    glm::vec3 center = bounds.center();
+    float radius = 0.0f;
+    for (const Vertex& vertex : mesh_vertices)
+        radius = std::max(radius, glm::length(vertex.pos - center));
+
+    IndirectMesh mesh;
+    mesh.first_index = static_cast<GLuint>(indices.size());
+    mesh.index_count = static_cast<GLuint>(mesh_indices.size());
+    mesh.base_vertex = static_cast<GLint>(vertices.size());
+    mesh.sphere = glm::vec4(center, radius);
+    meshes.push_back(mesh);
+
+    vertices.insert(vertices.end(), mesh_vertices.begin(), mesh_vertices.end());
+    indices.insert(indices.end(), mesh_indices.begin(), mesh_indices.end());
+    meshes_dirty = true;
+    return static_cast<unsigned int>(meshes.size() - 1);
+}
+
+unsigned int IndirectScene::addMaterial(const glm::vec4& color) {
+    materials.push_back(color);
+    objects_dirty = true;
+    return static_cast<unsigned int>(materials.size() - 1);
+}
+
+unsigned int IndirectScene::addObject(unsigned int mesh, unsigned int material, const glm::mat4& model) {
+    IndirectDraw draw;
+    draw.transform = static_cast<GLuint>(transforms.size());
+    draw.material = material;
+    draw.mesh = mesh;
+    transforms.push_back(model);
+    draws.push_back(draw);
+    objects_dirty = true;
+    return static_cast<unsigned int>(draws.size() - 1);
+}
+
+void IndirectScene::clearObjects() {
+    transforms.clear();
+    draws.clear();
+    objects_dirty = true;
+}
+
+void IndirectScene::setTransform(unsigned int object, const glm::mat4& model) {
+    size_t index = draws[object].transform;
+    transforms[index] = model;
+    dirty_begin = std::min(dirty_begin, index);
+    dirty_end = std::max(dirty_end, index + 1);
+}
+
+void IndirectScene::upload() {
+    if (meshes_dirty) {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        if (indirect_shader) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, mesh_ssbo);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, meshes.size() * sizeof(IndirectMesh), meshes.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+        meshes_dirty = false;
+    }
+
+    size_t begin = dirty_begin, end = dirty_end;
+    dirty_begin = SIZE_MAX;
+    dirty_end = 0;
+    if (!indirect_shader)
+        return;
+
+    if (objects_dirty) {
+        objects_dirty = false;
+
+        // One command per object, its base instance selects the object's entry in the draw SSBO
+        std::vector<DrawElementsCommand> commands(draws.size());
+        std::vector<GLuint> draw_ids(draws.size());
+        for (size_t i = 0; i < draws.size(); i++) {
+            const IndirectMesh& mesh = meshes[draws[i].mesh];
+            commands[i] = { mesh.index_count, 1, mesh.first_index, mesh.base_vertex, static_cast<GLuint>(i) };
+            draw_ids[i] = static_cast<GLuint>(i);
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, draw_id_vbo);
+        glBufferData(GL_ARRAY_BUFFER, draw_ids.size() * sizeof(GLuint), draw_ids.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsCommand), commands.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culled_command_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsCommand), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, transforms.size() * sizeof(glm::mat4), transforms.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, draw_ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, draws.size() * sizeof(IndirectDraw), draws.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, material_ssbo);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(glm::vec4), materials.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        stats.uploaded = transforms.size() * sizeof(glm::mat4);
+    }
+    else if (begin < end) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, transform_ssbo);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, begin * sizeof(glm::mat4), (end - begin) * sizeof(glm::mat4), &transforms[begin]);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        stats.uploaded = (end - begin) * sizeof(glm::mat4);
+    }
+}
+
+void IndirectScene::cull(const glm::mat4& proj_view) {
+    // Count of a dispatch READBACK_FRAMES - 1 frames ago, normally long finished
+    readback_frame = (readback_frame + 1) % READBACK_FRAMES;
+    glBindBuffer(GL_COPY_READ_BUFFER, readback_buffers[readback_frame]);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(GLuint), &stats.visible);
+
+    GLuint zero = 0;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, counter_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, 0, sizeof(GLuint), &zero);
+
+    Frustum frustum(proj_view);
+    cull_shader->use();
+    for (int p = 0; p < 6; p++)
+        cull_shader->setVec4(std::format("planes[{}]", p), frustum.planes[p]);
+    cull_shader->setInt("object_count", static_cast<int>(draws.size()));
+    cull_shader->setBool("compact", GLAD_GL_VERSION_4_6);
+    // The pyramid is only trusted for the frame right after it was built
+    cull_shader->setBool("use_hiz", hiz_occlusion && hiz_valid);
+    hiz_valid = false;
+    cull_shader->setMat4("hiz_proj_view", hiz_proj_view);
+    cull_shader->setInt("hiz_levels", hiz_levels);
+    cull_shader->setInt("hiz", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hiz_texture);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_BINDING, transform_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BINDING, draw_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, mesh_ssbo);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMAND_BINDING, culled_command_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNTER_BINDING, counter_buffer);
+    glDispatchCompute(static_cast<GLuint>((draws.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, counter_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readback_buffers[readback_frame]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(GLuint));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void IndirectScene::draw(const glm::vec3& light_dir, const glm::mat4& proj_view) {
+    auto start = std::chrono::high_resolution_clock::now();
+    stats = IndirectStats();
+    stats.objects = static_cast<unsigned int>(draws.size());
+    stats.indirect = use_indirect && indirect_shader;
+    stats.gpu_culled = stats.indirect && gpu_culling;
+    stats.visible = stats.objects;
+
+    upload();
+    if (draws.empty())
+        return;
+
+    glBindVertexArray(vao);
+    if (stats.indirect) {
+        GLsizei count = static_cast<GLsizei>(draws.size());
+        if (stats.gpu_culled)
+            cull(proj_view);
+
+        indirect_shader->use();
+        indirect_shader->setVec3("light_dir", light_dir);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TRANSFORM_BINDING, transform_ssbo);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_BINDING, draw_ssbo);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BINDING, material_ssbo);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, stats.gpu_culled ? culled_command_buffer : command_buffer);
+        if (stats.gpu_culled && GLAD_GL_VERSION_4_6) {
+            // Survivors are packed at the front, the GPU reads how many from the counter
+            glBindBuffer(GL_PARAMETER_BUFFER, counter_buffer);
+            glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, 0, count, 0);
+            glBindBuffer(GL_PARAMETER_BUFFER, 0);
+        }
+        else
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, count, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        stats.draw_calls = 1;
+    }
+    else {
+        fallback_shader.use();
+        fallback_shader.setVec3("light_dir", light_dir);
+        for (const IndirectDraw& draw : draws) {
+            const IndirectMesh& mesh = meshes[draw.mesh];
+            fallback_shader.setMat4("model", transforms[draw.transform]);
+            fallback_shader.setVec4("material_color", materials[draw.material]);
+            glDrawElementsBaseVertex(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT,
+                (void*)(mesh.first_index * sizeof(unsigned int)), mesh.base_vertex);
+        }
+        stats.draw_calls = stats.objects;
+    }
+    glBindVertexArray(0);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.submit_ms = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void IndirectScene::buildHiZ(GLuint depth_texture, unsigned int width, unsigned int height, const glm::mat4& proj_view) {
+    if (!hiz_shader || width == 0 || height == 0)
+        return;
+
+    if (width != hiz_width || height != hiz_height) {
+        glDeleteTextures(1, &hiz_texture);
+        hiz_width = width;
+        hiz_height = height;
+        hiz_levels = 1;
+        while ((std::max(width, height) >> hiz_levels) > 0)
+            hiz_levels++;
+
+        glGenTextures(1, &hiz_texture);
+        glBindTexture(GL_TEXTURE_2D, hiz_texture);
+        glTexStorage2D(GL_TEXTURE_2D, hiz_levels, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // Level 0 copies the depth buffer, every further level keeps the farthest depth of the texels it covers
+    hiz_shader->use();
+    hiz_shader->setInt("src", 0);
+    glActiveTexture(GL_TEXTURE0);
+    for (int level = 0; level < hiz_levels; level++) {
+        glBindTexture(GL_TEXTURE_2D, level == 0 ? depth_texture : hiz_texture);
+        hiz_shader->setBool("copy", level == 0);
+        hiz_shader->setInt("src_level", std::max(0, level - 1));
+        glBindImageTexture(0, hiz_texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        GLuint level_width = std::max(1u, width >> level), level_height = std::max(1u, height >> level);
+        glDispatchCompute((level_width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (level_height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    hiz_proj_view = proj_view;
+    hiz_valid = true;
+}
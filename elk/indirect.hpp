@@ -0,0 +1,141 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "common.hpp"
+#include "shader.hpp"
+
+// Layout of the commands glMultiDrawElementsIndirect reads
+struct DrawElementsCommand {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+// Per-draw data in the draw SSBO, std430
+struct IndirectDraw {
+    GLuint transform;
+    GLuint material;
+    GLuint mesh;
+    GLuint pad = 0;
+};
+
+// Object space bounding sphere and index range of a mesh in the shared buffers, std430
+struct IndirectMesh {
+    GLuint first_index, index_count;
+    GLint base_vertex;
+    GLuint pad = 0;
+    glm::vec4 sphere;
+};
+
+struct IndirectStats {
+    unsigned int objects = 0;
+    unsigned int draw_calls = 0;
+    float submit_ms = 0.0f;
+    bool indirect = false;
+    // GPU culling results, a few frames old
+    bool gpu_culled = false;
+    unsigned int visible = 0;
+    // Transform bytes uploaded this frame
+    size_t uploaded = 0;
+};
+
+// Objects whose meshes live in one shared vertex and index buffer. On GL 4.3 contexts all of them are drawn with a
+// single glMultiDrawElementsIndirect: the command's base instance feeds an instanced draw index attribute, which
+// indirect.vert uses to fetch the transform and material from SSBOs. Older contexts, or use_indirect off, draw the
+// same buffers one object at a time with uniforms, like the rest of the renderer.
+//
+// With gpu_culling the commands are written every frame by indirect_cull.comp, which tests each object's bounding
+// sphere against the frustum and against a Hi-Z pyramid of the previous frame's depth. On 4.6 survivors are compacted
+// and drawn with glMultiDrawElementsIndirectCount, on 4.3 culled commands keep their slot with no instances. The CPU
+// only uploads transforms that changed.
+class IndirectScene {
+public:
+    bool use_indirect = true;
+    bool gpu_culling = true;
+    bool hiz_occlusion = true;
+
+    IndirectScene();
+    ~IndirectScene();
+
+    IndirectScene(const IndirectScene&) = delete;
+    IndirectScene& operator=(const IndirectScene&) = delete;
+
+    static bool isSupported() {
+        return GLAD_GL_VERSION_4_3;
+    }
+
+    // Meshes and materials are appended, the returned indices refer to them
+    unsigned int addMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+    unsigned int addMaterial(const glm::vec4& color);
+    unsigned int addObject(unsigned int mesh, unsigned int material, const glm::mat4& model);
+
+    // Removes the objects, meshes and materials stay
+    void clearObjects();
+
+    const glm::mat4& getTransform(unsigned int object) const {
+        return transforms[draws[object].transform];
+    }
+    // Only the range of changed transforms is uploaded, so update neighbouring objects together
+    void setTransform(unsigned int object, const glm::mat4& model);
+
+    // Draws every object with the bound camera block, light_dir in view space. Proj_view is the camera the
+    // objects are culled for.
+    void draw(const glm::vec3& light_dir, const glm::mat4& proj_view);
+
+    // Builds the occlusion pyramid from the depth buffer proj_view rendered, used by the next frame's culling
+    void buildHiZ(GLuint depth_texture, unsigned int width, unsigned int height, const glm::mat4& proj_view);
+
+    size_t getObjectCount() const {
+        return draws.size();
+    }
+
+    const IndirectStats& getStats() const {
+        return stats;
+    }
+
+private:
+    static const int READBACK_FRAMES = 3;
+
+    // Only compiled on contexts that support it
+    std::unique_ptr<Shader> indirect_shader, cull_shader, hiz_shader;
+    Shader fallback_shader;
+
+    GLuint vao, vbo, ebo, draw_id_vbo;
+    GLuint transform_ssbo = 0, draw_ssbo = 0, material_ssbo = 0, mesh_ssbo = 0, command_buffer = 0;
+    // Written by the culling shader, the counter doubles as the parameter buffer of the count draw
+    GLuint culled_command_buffer = 0, counter_buffer = 0;
+    GLuint readback_buffers[READBACK_FRAMES] = {};
+    int readback_frame = 0;
+
+    GLuint hiz_texture = 0;
+    unsigned int hiz_width = 0, hiz_height = 0;
+    int hiz_levels = 0;
+    bool hiz_valid = false;
+    glm::mat4 hiz_proj_view = glm::mat4(1.0f);
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<IndirectMesh> meshes;
+    std::vector<glm::vec4> materials;
+    std::vector<glm::mat4> transforms;
+    std::vector<IndirectDraw> draws;
+
+    bool meshes_dirty = false, objects_dirty = false;
+    // Range of transforms changed since the last upload
+    size_t dirty_begin = SIZE_MAX, dirty_end = 0;
+    IndirectStats stats;
+
+    void upload();
+    void cull(const glm::mat4& proj_view);
+};
+
+#endif // !INDIRECT_H
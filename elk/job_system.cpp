@@ -0,0 +1,210 @@
+#include "job_system.hpp"
+
+#include <json.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    // -1 on threads the system does not know, they push to the main thread's deque but never run jobs
+    thread_local int thread_index = -1;
+
+    int queueIndex() {
+        return std::max(0, thread_index);
+    }
+}
+
+JobSystem::JobSystem(int nr_workers) :
+    queues(std::max(0, nr_workers) + 1)
+{
+    thread_index = 0;
+    for (int i = 1; i < static_cast<int>(queues.size()); i++)
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        running = false;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+JobSystem& JobSystem::get() {
+    static JobSystem instance;
+    return instance;
+}
+
+int JobSystem::getThreadIndex() {
+    return queueIndex();
+}
+
+void JobSystem::run(const char* name, Job job, JobCounter* counter) {
+    if (counter)
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+    Queue& queue = queues[queueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({ name, std::move(job), counter });
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders this against a worker that just found nothing and is about to sleep
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake.notify_one();
+}
+
+void JobSystem::runOnMain(const char* name, Job job, JobCounter* counter) {
+    if (counter)
+        counter->count.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(main_mutex);
+    main_jobs.push_back({ name, std::move(job), counter });
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    // Outside threads only yield, a job run there would see thread index 0 and share the main thread's slot in
+    // per-thread data such as draw recorders
+    while (!counter.done()) {
+        if (thread_index == 0)
+            runMainJobs();
+        if (thread_index < 0 || !runOne(thread_index))
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::runMainJobs() {
+    std::vector<QueuedJob> jobs;
+    {
+        std::lock_guard<std::mutex> lock(main_mutex);
+        jobs.swap(main_jobs);
+    }
+    for (QueuedJob& job : jobs) {
+        execute(job, 0);
+        nr_main_jobs++;
+    }
+}
+
+void JobSystem::parallelFor(const char* name, size_t count, size_t batch, const std::function<void(size_t, size_t)>& body) {
+    batch = std::max<size_t>(1, batch);
+    if (count <= batch) {
+        if (count > 0)
+            body(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (size_t begin = 0; begin < count; begin += batch) {
+        size_t end = std::min(count, begin + batch);
+        run(name, [&body, begin, end]() { body(begin, end); }, &counter);
+    }
+    wait(counter);
+}
+
+size_t JobSystem::getBatchSize(size_t count, size_t item_size) const {
+    size_t per_line = std::max<size_t>(1, CACHE_LINE / std::max<size_t>(1, item_size));
+    size_t batches = 4 * queues.size();
+    size_t batch = (count + batches - 1) / batches;
+    return std::max(per_line, (batch + per_line - 1) / per_line * per_line);
+}
+
+JobStats JobSystem::collectStats() {
+    JobStats stats;
+    stats.jobs = nr_jobs.exchange(0);
+    stats.stolen = nr_stolen.exchange(0);
+    stats.main_jobs = nr_main_jobs.exchange(0);
+    return stats;
+}
+
+void JobSystem::beginTrace() {
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    trace_events.clear();
+    trace_start = std::chrono::high_resolution_clock::now();
+    tracing = true;
+}
+
+bool JobSystem::endTrace(const std::string& path) {
+    tracing = false;
+    std::lock_guard<std::mutex> lock(trace_mutex);
+
+    nlohmann::json events = nlohmann::json::array();
+    for (int t = 0; t < getThreadCount(); t++) {
+        events.push_back({ { "name", "thread_name" }, { "ph", "M" }, { "pid", 0 }, { "tid", t },
+            { "args", { { "name", t == 0 ? std::string("Main") : "Worker " + std::to_string(t) } } } });
+    }
+    for (const TraceEvent& event : trace_events) {
+        events.push_back({ { "name", event.name }, { "ph", "X" }, { "pid", 0 }, { "tid", event.thread },
+            { "ts", event.start_us }, { "dur", event.duration_us } });
+    }
+
+    std::ofstream file(path);
+    if (!file) {
+        std::cout << "ERROR::JOB_SYSTEM:: Could not write trace " << path << std::endl;
+        return false;
+    }
+    file << nlohmann::json{ { "traceEvents", events } }.dump();
+    return true;
+}
+
+void JobSystem::workerLoop(int index) {
+    thread_index = index;
+    while (true) {
+        if (runOne(index))
+            continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [this]() { return !running || queued.load(std::memory_order_acquire) > 0; });
+        if (!running)
+            return;
+    }
+}
+
+bool JobSystem::runOne(int index) {
+    QueuedJob job;
+    bool found = false;
+    {
+        Queue& own = queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            found = true;
+        }
+    }
+    for (size_t k = 1; !found && k < queues.size(); k++) {
+        Queue& victim = queues[(index + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            found = true;
+            nr_stolen++;
+        }
+    }
+    if (!found)
+        return false;
+
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    execute(job, index);
+    nr_jobs++;
+    return true;
+}
+
+void JobSystem::execute(QueuedJob& job, int index) {
+    if (!tracing.load(std::memory_order_relaxed))
+        job.job();
+    else {
+        auto start = std::chrono::high_resolution_clock::now();
+        job.job();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        trace_events.push_back({ job.name, index,
+            std::chrono::duration<double, std::micro>(start - trace_start).count(),
+            std::chrono::duration<double, std::micro>(end - start).count() });
+    }
+    if (job.counter)
+        job.counter->count.fetch_sub(1, std::memory_order_release);
+}
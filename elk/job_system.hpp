@@ -0,0 +1,127 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Number of jobs that still have to finish, wait() on it helps running jobs until it reaches zero
+class JobCounter {
+public:
+    bool done() const {
+        return count.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> count = 0;
+};
+
+struct JobStats {
+    unsigned int jobs = 0;
+    unsigned int stolen = 0;
+    unsigned int main_jobs = 0;
+};
+
+// Worker threads with one deque each, the creating thread owns deque 0 and is treated as the main thread. Owners
+// push and pop at the back, idle threads steal the oldest job from the front of another deque. Jobs that need the GL
+// context go to a separate main lane that only the main thread runs, either while it waits on a counter or in
+// runMainJobs. Job execution can be recorded as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+class JobSystem {
+public:
+    using Job = std::function<void()>;
+
+    static const size_t CACHE_LINE = 64;
+
+    explicit JobSystem(int nr_workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+    ~JobSystem();
+
+    // Shared instance, created by the first call which makes that thread the main thread
+    static JobSystem& get();
+
+    // 0 on the main thread and threads outside of the system, 1 to getThreadCount() - 1 on workers. Jobs only run
+    // on the main thread and workers, so inside a job the index belongs to one thread.
+    static int getThreadIndex();
+
+    int getThreadCount() const {
+        return static_cast<int>(queues.size());
+    }
+
+    void run(const char* name, Job job, JobCounter* counter = nullptr);
+    void runOnMain(const char* name, Job job, JobCounter* counter = nullptr);
+
+    // Runs queued jobs until counter is done, the main thread also runs its lane. Outside threads just yield.
+    void wait(JobCounter& counter);
+
+    // Runs the main lane jobs queued so far, only call on the main thread
+    void runMainJobs();
+
+    // Calls body(begin, end) on batches of [0, count) and waits for all of them
+    void parallelFor(const char* name, size_t count, size_t batch, const std::function<void(size_t, size_t)>& body);
+
+    // Batch size for loops writing items of item_size bytes by index. Batches are whole cache lines so neighbors
+    // never write to the same line, and there are a few per thread so stealing can even out uneven batches.
+    size_t getBatchSize(size_t count, size_t item_size) const;
+
+    // Returns the counts since the last call
+    JobStats collectStats();
+
+    void beginTrace();
+    // Writes the jobs run since beginTrace as Chrome trace events
+    bool endTrace(const std::string& path);
+
+    bool isTracing() const {
+        return tracing.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct QueuedJob {
+        const char* name;
+        Job job;
+        JobCounter* counter;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<QueuedJob> jobs;
+    };
+
+    struct TraceEvent {
+        const char* name;
+        int thread;
+        double start_us, duration_us;
+    };
+
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running = true;
+
+    // Jobs waiting in any deque, idle workers sleep while there are none
+    std::atomic<int> queued = 0;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+
+    std::mutex main_mutex;
+    std::vector<QueuedJob> main_jobs;
+
+    std::atomic<unsigned int> nr_jobs = 0, nr_stolen = 0, nr_main_jobs = 0;
+
+    std::atomic<bool> tracing = false;
+    std::mutex trace_mutex;
+    std::vector<TraceEvent> trace_events;
+    std::chrono::high_resolution_clock::time_point trace_start;
+
+    void workerLoop(int index);
+    bool runOne(int index);
+    void execute(QueuedJob& job, int index);
+};
+
+#endif // !JOB_SYSTEM_H
@@ -0,0 +1,243 @@
+#include "light_clusters.hpp"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "job_system.hpp"
+#include "shader_utils.hpp"
+
+// Texels per light in light_data: view space position and radius, ambient, diffuse, specular, visibility
+const unsigned int LIGHT_TEXELS = 5;
+
+static GLuint makeTextureBuffer(GLuint& buffer, GLenum format) {
+    GLuint texture;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return texture;
+}
+
+template <typename T>
+static void uploadTextureBuffer(GLuint buffer, const std::vector<T>& data) {
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    // Respecifying the whole store orphans the previous frame's data instead of waiting for it
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(data.size() * sizeof(T), 16), NULL, GL_STREAM_DRAW);
+    if (!data.empty())
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, data.size() * sizeof(T), data.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightClusters::LightClusters(glm::uvec3 dims) :
+    dims(glm::max(dims, glm::uvec3(1)))
+{
+    cluster_grid.resize(this->dims.x * this->dims.y * this->dims.z);
+    slice_indices.resize(this->dims.z);
+
+    grid_texture = makeTextureBuffer(grid_buffer, GL_RG32UI);
+    index_texture = makeTextureBuffer(index_buffer, GL_R32UI);
+    light_texture = makeTextureBuffer(light_buffer, GL_RGBA32F);
+}
+
+LightClusters::~LightClusters() {
+    GLuint textures[] = { grid_texture, index_texture, light_texture };
+    GLuint buffers[] = { grid_buffer, index_buffer, light_buffer };
+    glDeleteTextures(3, textures);
+    glDeleteBuffers(3, buffers);
+}
+
+void LightClusters::buildClusterBounds(float fov_y, float aspect) {
+    cluster_bounds.resize(cluster_grid.size());
+    float tan_y = std::tan(fov_y * 0.5f);
+    float tan_x = tan_y * aspect;
+
+    for (unsigned int z = 0; z < dims.z; z++) {
+        // Exponential slices keep clusters roughly cubic along the view direction
+        float d0 = z_near * std::pow(z_far / z_near, static_cast<float>(z) / dims.z);
+        float d1 = z_near * std::pow(z_far / z_near, static_cast<float>(z + 1) / dims.z);
+
+        for (unsigned int y = 0; y < dims.y; y++) {
+            float y0 = -1.0f + 2.0f * y / dims.y, y1 = -1.0f + 2.0f * (y + 1) / dims.y;
+            for (unsigned int x = 0; x < dims.x; x++) {
+                float x0 = -1.0f + 2.0f * x / dims.x, x1 = -1.0f + 2.0f * (x + 1) / dims.x;
+
+                AABB box;
+                for (float d : { d0, d1 })
+                    for (float ndc_x : { x0, x1 })
+                        for (float ndc_y : { y0, y1 })
+                            box.expand(glm::vec3(ndc_x * d * tan_x, ndc_y * d * tan_y, -d));
+                cluster_bounds[x + dims.x * (y + dims.y * z)] = box;
+            }
+        }
+    }
+}
+
+void LightClusters::update(const std::vector<PointLight*>& lights, const glm::mat4& view, float fov_y, float aspect, float z_near, float z_far) {
+    glm::vec4 params(fov_y, aspect, z_near, z_far);
+    if (params != projection_params) {
+        projection_params = params;
+        this->z_near = z_near;
+        this->z_far = z_far;
+        buildClusterBounds(fov_y, aspect);
+    }
+
+    nr_lights = static_cast<unsigned int>(lights.size());
+    light_x.resize(nr_lights);
+    light_y.resize(nr_lights);
+    light_z.resize(nr_lights);
+    light_radius.resize(nr_lights);
+    light_data.resize(nr_lights * LIGHT_TEXELS);
+
+    for (unsigned int i = 0; i < nr_lights; i++) {
+        const PointLight& light = *lights[i];
+        glm::vec3 view_pos = glm::vec3(view * glm::vec4(glm::vec3(light.pos), 1.0f));
+        glm::vec3 peak = glm::max(glm::vec3(light.ambient), glm::max(glm::vec3(light.diffuse), glm::vec3(light.specular)));
+        float radius = getLightRadius(light.visibility, std::max(peak.x, std::max(peak.y, peak.z)));
+
+        light_x[i] = view_pos.x;
+        light_y[i] = view_pos.y;
+        light_z[i] = view_pos.z;
+        light_radius[i] = radius;
+
+        glm::vec4* texels = &light_data[i * LIGHT_TEXELS];
+        texels[0] = glm::vec4(view_pos, radius);
+        texels[1] = light.ambient;
+        texels[2] = light.diffuse;
+        texels[3] = light.specular;
+        texels[4] = glm::vec4(light.visibility, 0.0f);
+    }
+
+    // Slices are independent, each job writes its own index lists
+    JobSystem::get().parallelFor("Light binning", dims.z, 1, [this](size_t begin, size_t end) {
+        binSlices(static_cast<unsigned int>(begin), static_cast<unsigned int>(end));
+    });
+
+    light_indices.clear();
+    unsigned int slice_size = dims.x * dims.y;
+    for (unsigned int z = 0; z < dims.z; z++) {
+        GLuint base = static_cast<GLuint>(light_indices.size());
+        for (unsigned int i = z * slice_size; i < (z + 1) * slice_size; i++)
+            cluster_grid[i].x += base;
+        light_indices.insert(light_indices.end(), slice_indices[z].begin(), slice_indices[z].end());
+    }
+
+    uploadTextureBuffer(grid_buffer, cluster_grid);
+    uploadTextureBuffer(index_buffer, light_indices);
+    uploadTextureBuffer(light_buffer, light_data);
+}
+
+// Lights in SoA form, padded to a multiple of 4 with never matching entries
+struct LightSet {
+    std::vector<float> x, y, z, r2;
+    std::vector<GLuint> index;
+
+    void clear() {
+        x.clear(); y.clear(); z.clear(); r2.clear(); index.clear();
+    }
+
+    void add(float cx, float cy, float cz, float radius2, GLuint light) {
+        x.push_back(cx); y.push_back(cy); z.push_back(cz); r2.push_back(radius2); index.push_back(light);
+    }
+
+    void pad() {
+        while (r2.size() % 4) {
+            x.push_back(0.0f); y.push_back(0.0f); z.push_back(0.0f); r2.push_back(-1.0f);
+        }
+    }
+};
+
+// Calls f(i) for every light i of the set whose sphere touches the box
+template <typename F>
+static void forOverlapping(const AABB& box, const LightSet& set, F&& f) {
+    __m128 min_x = _mm_set1_ps(box.min.x), max_x = _mm_set1_ps(box.max.x);
+    __m128 min_y = _mm_set1_ps(box.min.y), max_y = _mm_set1_ps(box.max.y);
+    __m128 min_z = _mm_set1_ps(box.min.z), max_z = _mm_set1_ps(box.max.z);
+    __m128 zero = _mm_setzero_ps();
+
+    // Squared distance from each sphere center to the box
+    for (size_t i = 0; i < set.index.size(); i += 4) {
+        __m128 cx = _mm_loadu_ps(&set.x[i]);
+        __m128 cy = _mm_loadu_ps(&set.y[i]);
+        __m128 cz = _mm_loadu_ps(&set.z[i]);
+
+        __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_x, cx), _mm_sub_ps(cx, max_x)), zero);
+        __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_y, cy), _mm_sub_ps(cy, max_y)), zero);
+        __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(min_z, cz), _mm_sub_ps(cz, max_z)), zero);
+        __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        unsigned int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&set.r2[i])));
+        while (mask) {
+            f(i + std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+}
+
+void LightClusters::binSlices(unsigned int first_slice, unsigned int last_slice) {
+    LightSet slice_lights, row_lights;
+    unsigned int slice_size = dims.x * dims.y;
+
+    for (unsigned int z = first_slice; z < last_slice; z++) {
+        std::vector<GLuint>& indices = slice_indices[z];
+        indices.clear();
+
+        const AABB& slice_box = cluster_bounds[z * slice_size];
+        float slice_min = slice_box.min.z, slice_max = slice_box.max.z;
+
+        slice_lights.clear();
+        for (unsigned int i = 0; i < nr_lights; i++) {
+            if (light_z[i] - light_radius[i] > slice_max || light_z[i] + light_radius[i] < slice_min)
+                continue;
+            slice_lights.add(light_x[i], light_y[i], light_z[i], light_radius[i] * light_radius[i], i);
+        }
+        slice_lights.pad();
+
+        // Narrow the lights down per row of tiles before testing single clusters
+        for (unsigned int y = 0; y < dims.y; y++) {
+            unsigned int row = z * slice_size + y * dims.x;
+            AABB row_box = cluster_bounds[row];
+            row_box.expand(cluster_bounds[row + dims.x - 1]);
+
+            row_lights.clear();
+            forOverlapping(row_box, slice_lights, [&](size_t i) {
+                row_lights.add(slice_lights.x[i], slice_lights.y[i], slice_lights.z[i], slice_lights.r2[i], slice_lights.index[i]);
+            });
+            row_lights.pad();
+
+            for (unsigned int c = row; c < row + dims.x; c++) {
+                GLuint offset = static_cast<GLuint>(indices.size());
+                forOverlapping(cluster_bounds[c], row_lights, [&](size_t i) {
+                    indices.push_back(row_lights.index[i]);
+                });
+                cluster_grid[c] = glm::uvec2(offset, static_cast<GLuint>(indices.size()) - offset);
+            }
+        }
+    }
+}
+
+void LightClusters::bind(Shader& shader, const glm::vec2& viewport, GLuint first_unit) const {
+    glActiveTexture(GL_TEXTURE0 + first_unit);
+    glBindTexture(GL_TEXTURE_BUFFER, grid_texture);
+    glActiveTexture(GL_TEXTURE0 + first_unit + 1);
+    glBindTexture(GL_TEXTURE_BUFFER, index_texture);
+    glActiveTexture(GL_TEXTURE0 + first_unit + 2);
+    glBindTexture(GL_TEXTURE_BUFFER, light_texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    float log_range = std::log(z_far / z_near);
+    shader.use();
+    shader.setInt("cluster_grid", first_unit);
+    shader.setInt("light_indices", first_unit + 1);
+    shader.setInt("light_data", first_unit + 2);
+    shader.setVec3("cluster_dims", glm::vec3(dims));
+    shader.setVec2("cluster_tile_size", viewport / glm::vec2(dims.x, dims.y));
+    shader.setFloat("cluster_z_scale", dims.z / log_range);
+    shader.setFloat("cluster_z_bias", -(dims.z * std::log(z_near)) / log_range);
+}
@@ -0,0 +1,58 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "common.hpp"
+#include "culling.hpp"
+#include "shader.hpp"
+
+// Clustered forward lighting. Point lights are binned on the CPU into a view space froxel grid with exponential
+// depth slices, the grid, light index lists and light parameters are uploaded as texture buffers and
+// phong_clustered.frag only evaluates the lights listed for its cluster.
+class LightClusters {
+public:
+    const glm::uvec3 dims;
+
+    LightClusters(glm::uvec3 dims = glm::uvec3(16, 9, 24));
+    ~LightClusters();
+
+    void update(const std::vector<PointLight*>& lights, const glm::mat4& view, float fov_y, float aspect, float z_near, float z_far);
+
+    // Binds the texture buffers starting at first_unit and sets the cluster uniforms
+    void bind(Shader& shader, const glm::vec2& viewport, GLuint first_unit = 4) const;
+
+    unsigned int getLightCount() const {
+        return nr_lights;
+    }
+
+    size_t getIndexCount() const {
+        return light_indices.size();
+    }
+
+private:
+    // Per light SoA data used for binning
+    std::vector<float> light_x, light_y, light_z, light_radius;
+    std::vector<glm::vec4> light_data;
+    unsigned int nr_lights = 0;
+
+    std::vector<AABB> cluster_bounds;
+    glm::vec4 projection_params = glm::vec4(0.0f);
+    float z_near = 0.1f, z_far = 100.0f;
+
+    std::vector<glm::uvec2> cluster_grid;
+    std::vector<GLuint> light_indices;
+    std::vector<std::vector<GLuint>> slice_indices;
+
+    GLuint grid_buffer, grid_texture;
+    GLuint index_buffer, index_texture;
+    GLuint light_buffer, light_texture;
+
+    void buildClusterBounds(float fov_y, float aspect);
+    void binSlices(unsigned int first_slice, unsigned int last_slice);
+};
+
+#endif // !LIGHT_CLUSTERS_H
@@ -17,12 +17,34 @@
 #include <format>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <vector>
 
+#include "bvh.hpp"
 #include "camera.hpp"
+#include "culling.hpp"
+#include "deferred.hpp"
+#include "draw_list.hpp"
+#include "dynamic_resolution.hpp"
+#include "frame_graph.hpp"
+#include "gpu_queries.hpp"
+#include "indirect.hpp"
+#include "job_system.hpp"
+#include "light_clusters.hpp"
+#include "mandelbrot.hpp"
+#include "mandelbrot_cpu.hpp"
 #include "model_loader.hpp"
+#include "occlusion.hpp"
+#include "occlusion_queries.hpp"
+#include "outline.hpp"
+#include "post_processing.hpp"
 #include "shader.hpp"
 #include "shader_utils.hpp"
+#include "shadows.hpp"
+#include "simulation.hpp"
+#include "stream_buffer.hpp"
+#include "stb_image.h"
+#include "temporal_aa.hpp"
 #include "window_callbacks.hpp"
 
 std::vector<Vertex> generateSquareVertices(float x) {
@@ -37,14 +59,48 @@ std::vector<Vertex> generateSquareVertices(float x) {
     return vertices;
 }
 
-int main() {
+// Renders the default fractal view on the CPU without creating a window and optionally checks it against a golden
+// image: elk --mandelbrot out.png [size] [golden.png]
+int renderMandelbrotHeadless(int argc, char** argv) {
+    unsigned int size = argc > 3 ? static_cast<unsigned int>(std::max(1, std::atoi(argv[3]))) : 1024;
+    CpuMandelbrot cpu_mandelbrot;
+    std::vector<float> iterations = cpu_mandelbrot.render(MandelbrotView(), size);
+    const CpuMandelbrotStats& stats = cpu_mandelbrot.getStats();
+    std::cout << std::format("Mandelbrot {}x{}: {:.1f} ms, {:.1f} Mpix/s, {} tiles on {} threads",
+        size, size, stats.ms, stats.mpix_per_s, stats.tiles, stats.threads) << std::endl;
+
+    std::vector<unsigned char> rgb = CpuMandelbrot::colorize(iterations, size);
+    if (!CpuMandelbrot::writePng(argv[2], rgb, size, size))
+        return 1;
+    if (argc <= 4)
+        return 0;
+
+    int width, height, channels;
+    unsigned char* golden = stbi_load(argv[4], &width, &height, &channels, 3);
+    if (!golden) {
+        std::cout << "ERROR::MANDELBROT:: Could not load golden image " << argv[4] << std::endl;
+        return 1;
+    }
+    MandelbrotDifference difference = CpuMandelbrot::compare(rgb, std::vector<unsigned char>(golden, golden + width * height * 3));
+    stbi_image_free(golden);
+    std::cout << std::format("Golden image: {} pixels differ, max error {}", difference.mismatched, difference.max_error) << std::endl;
+    return difference.mismatched == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && std::string(argv[1]) == "--mandelbrot")
+        return renderMandelbrotHeadless(argc, argv);
+
+    // The context version is picked by bindWindow
     glfwInit();
     {
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     }
 
+    // Shared by asset loading, culling, light binning and draw recording, this becomes its main thread
+    JobSystem& jobs = JobSystem::get();
+    int trace_frames = 0;
+
     // Initialize windows and attach camera -----------------------------------------------------
     Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
     GLFWwindow* window = bindWindow(1280, 720, &camera, "Model Viwer");
@@ -66,13 +122,18 @@ int main() {
 
     // Initialize shaders -----------------------------------------------------------------------
     Shader lights_shader("shaders/phong.vert", "shaders/phong.frag");
+    Shader clustered_shader("shaders/phong.vert", "shaders/phong_clustered.frag");
     Shader depth_shader("shaders/phong.vert", "shaders/depth.frag");
     Shader normal_shader("shaders/phong.vert", "shaders/shiny.frag");
-    Shader outline_shader("shaders/phong.vert", "shaders/outline.frag");
     Shader light_source_shader("shaders/light.vert", "shaders/light.frag");
-    Shader screen_shader("shaders/screen.vert", "shaders/screen_postprocess.frag");
-    Shader mandelbrot_shader("shaders/screen.vert", "shaders/mandelbrot.frag");
-    Shader identity_shader("shaders/identity.vert", "shaders/identity.frag");
+    Shader prepass_shader("shaders/prepass.vert", "shaders/prepass.frag");
+    Shader prepass_alpha_shader("shaders/prepass_alpha.vert", "shaders/prepass_alpha.frag");
+    for (Shader* shader : { &lights_shader, &clustered_shader, &depth_shader, &normal_shader, &prepass_shader, &prepass_alpha_shader })
+        shader->bindUniformBlock("CameraBlock", CAMERA_BLOCK_BINDING);
+
+    // Per-frame uniform blocks and instance data, persistently mapped where the context has buffer storage
+    bool persistent_streaming = true, prev_persistent_streaming = persistent_streaming;
+    std::unique_ptr<StreamBuffer> frame_stream = std::make_unique<StreamBuffer>(4 << 20, persistent_streaming);
 
     // Initialize Models ------------------------------------------------------------------------
     Model test_object("models/backpack/backpack.obj", true, false);
@@ -80,6 +141,17 @@ int main() {
     Model grass("models/grass/grass.obj", false, true);
     Model chess_board("models/chess_board/chess_board.obj", true, false);
 
+    // Depth-only passes read 12 bytes per vertex instead of the full interleaved vertex
+    test_object.setupPositionStreams();
+    chess_board.setupPositionStreams();
+    size_t vertex_bytes = 0, position_bytes = 0;
+    for (Model* model : { &test_object, &chess_board }) {
+        for (const Mesh& mesh : model->getMeshes()) {
+            vertex_bytes += mesh.vertices.size() * sizeof(Vertex);
+            position_bytes += mesh.getPositionCount() * sizeof(glm::vec3);
+        }
+    }
+
     std::vector<std::string> faces = {
         "skybox/px.jpg",
         "skybox/nx.jpg",
@@ -126,6 +198,7 @@ int main() {
 
     // Attach pointers and transforms -----------------------------------------------------------
     std::vector<glm::vec2> dist;
+    std::vector<glm::mat4> grass_models;
 
     Shader* active_shader = &lights_shader;
     active_shader = &depth_shader;
@@ -133,8 +206,14 @@ int main() {
     int nr_grass = 10, nr_lights = 4;
     {
         dist.resize(nr_grass);
+        grass_models.resize(nr_grass);
         for (int i = 0; i < nr_grass; i++) {
             dist[i] = glm::diskRand(5.0f);
+
+            glm::mat4 model(1.0f);
+            model = glm::translate(model, glm::vec3(dist[i].x, 0.7f, dist[i].y));
+            model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+            grass_models[i] = model;
         }
 
         point_lights.resize(nr_lights);
@@ -155,25 +234,190 @@ int main() {
         &dir_light,
         &spot_light
     };
+    std::vector<Light*> clustered_lights = lights;
     lights.insert(lights.end(), point_lights.begin(), point_lights.end());
 
-    // Build framebuffer & Render Target --------------------------------------------------------
-    glm::vec2 ires(1600, 900);
-    RenderTarget target(ires.x, ires.y);
-    RenderTarget mandel(5, 5);
+    // Extra point lights for the clustered shader, orbiting the scene ---------------------------
+    LightClusters light_clusters;
+    std::vector<PointLight*> cluster_lights(point_lights.begin(), point_lights.end());
+    std::vector<glm::vec3> cluster_orbits;
+    int nr_cluster_lights = 1024;
+
+    auto spawnClusterLights = [&](int count) {
+        count = std::max(count, nr_lights);
+        for (size_t i = nr_lights; i < cluster_lights.size(); i++)
+            delete cluster_lights[i];
+        cluster_lights.resize(nr_lights);
+        cluster_orbits.resize(count - nr_lights);
+
+        for (int i = nr_lights; i < count; i++) {
+            glm::vec3 color = glm::linearRand(glm::vec3(0.1f), glm::vec3(1.0f));
+            PointLight* point_light = new PointLight(
+                glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                glm::vec4(0.0f, 0.0f, 0.0f, 1.0f),
+                glm::vec4(color * 0.5f, 1.0f),
+                glm::vec4(color * 0.5f, 1.0f),
+                i
+            );
+            point_light->visibility = getVisibility(1.5f);
+            // Orbit radius, start angle and height
+            glm::vec3& orbit = cluster_orbits[i - nr_lights];
+            orbit = glm::vec3(glm::sqrt(glm::linearRand(0.0f, 1.0f)) * 12.0f, glm::linearRand(0.0f, glm::two_pi<float>()), glm::linearRand(-0.2f, 2.0f));
+            point_light->pos = glm::vec4(orbit.x * glm::cos(orbit.y), orbit.z, orbit.x * glm::sin(orbit.y), 1.0f);
+            cluster_lights.push_back(point_light);
+        }
+    };
+    spawnClusterLights(nr_cluster_lights);
+
+    // Indirect draw benchmark, many small distinct objects around the scene --------------------
+    IndirectScene benchmark;
+    int nr_benchmark_objects = 10000;
+    bool show_benchmark = false;
+    bool animate_benchmark = false;
+    {
+        // Unit cube with per-face normals
+        std::vector<Vertex> cube_vertices;
+        std::vector<unsigned int> cube_indices;
+        for (int axis = 0; axis < 3; axis++) {
+            for (float side : { -1.0f, 1.0f }) {
+                glm::vec3 normal(0.0f), u(0.0f), v(0.0f);
+                normal[axis] = side;
+                u[(axis + 1) % 3] = 1.0f;
+                v[(axis + 2) % 3] = side;
+                unsigned int first = static_cast<unsigned int>(cube_vertices.size());
+                for (glm::vec2 corner : { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) })
+                    cube_vertices.push_back({ 0.5f * (normal + corner.x * u + corner.y * v), normal, (corner + 1.0f) * 0.5f });
+                cube_indices.insert(cube_indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+            }
+        }
+        benchmark.addMesh(cube_vertices, cube_indices);
+        for (const Mesh& mesh : bulb.getMeshes())
+            benchmark.addMesh(mesh.vertices, mesh.indices);
+        for (int i = 0; i < 16; i++)
+            benchmark.addMaterial(glm::vec4(glm::linearRand(glm::vec3(0.2f), glm::vec3(1.0f)), 1.0f));
+    }
+    unsigned int nr_benchmark_meshes = 1 + static_cast<unsigned int>(bulb.getMeshes().size());
+
+    auto spawnBenchmark = [&](int count) {
+        benchmark.clearObjects();
+        for (int i = 0; i < count; i++) {
+            float radius = glm::linearRand(14.0f, 40.0f), angle = glm::linearRand(0.0f, glm::two_pi<float>());
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(radius * glm::cos(angle), glm::linearRand(-0.3f, 12.0f), radius * glm::sin(angle)));
+            model = glm::rotate(model, glm::linearRand(0.0f, glm::two_pi<float>()), glm::sphericalRand(1.0f));
+            model = glm::scale(model, glm::vec3(glm::linearRand(0.1f, 0.4f)));
+            benchmark.addObject(i % nr_benchmark_meshes, i % 16, model);
+        }
+    };
+    spawnBenchmark(nr_benchmark_objects);
+
+    // Scene hierarchy, user data of each object is its index in object_names -------------------
+    BVH scene_bvh;
+    std::vector<std::string> object_names;
+    std::vector<int> object_proxies;
+
+    auto addObject = [&](const std::string& name, const Model& model, const glm::mat4& transform) {
+        object_names.push_back(name);
+        object_proxies.push_back(scene_bvh.insert(model.getBounds().transform(transform), static_cast<unsigned int>(object_names.size() - 1)));
+        return static_cast<unsigned int>(object_names.size() - 1);
+    };
+
+    glm::mat4 chess_board_model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.3f, 0.0f));
+    glm::mat4 test_object_model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.7f, 0.0f));
+    glm::mat4 prev_test_object_model = test_object_model;
+
+    unsigned int chess_board_id = addObject("Chess board", chess_board, chess_board_model);
+    unsigned int test_object_id = addObject("Test object", test_object, test_object_model);
+    unsigned int first_grass_id = static_cast<unsigned int>(object_names.size());
+    for (int i = 0; i < nr_grass; i++)
+        addObject(std::format("Grass {}", i), grass, grass_models[i]);
+    unsigned int first_bulb_id = static_cast<unsigned int>(object_names.size());
+    for (int i = 0; i < nr_lights; i++)
+        addObject(std::format("Light {}", i), bulb, glm::translate(glm::mat4(1.0f), point_light_positions[i]));
+
+    std::vector<unsigned int> visible_objects;
+    std::vector<unsigned char> object_visible(object_names.size());
+    std::vector<CullingBenchmark> culling_benchmark;
+
+    // Culling passes, stats are shown per pass on the dashboard --------------------------------
+    FrustumCuller scene_culler("Scene");
+    FrustumCuller prepass_culler("Depth pre-pass");
+    std::vector<FrustumCuller*> cull_passes = { &scene_culler, &prepass_culler };
+    // Redraws objects the scene pass already culled, so its counts are not shown
+    FrustumCuller velocity_culler("TAA velocity");
+
+    // Draws recorded on worker threads and replayed on this one
+    DrawList scene_draws, prepass_draws;
+
+    Occluder chess_board_occluder = makeOccluder(chess_board);
+    chess_board_occluder.model = chess_board_model;
+    const AABB& test_object_bounds = test_object.getBounds();
+    Occluder test_object_occluder = makeOccluder(test_object, 0.02f * glm::length(test_object_bounds.max - test_object_bounds.min));
+    std::vector<Occluder*> occluders = { &chess_board_occluder, &test_object_occluder };
+
+    OcclusionCuller occlusion_culler;
+    GLuint occlusion_debug_texture = 0;
+
+    // Heavy objects additionally go through hardware occlusion queries
+    OcclusionQueries occlusion_queries;
+    auto isHeavy = [](Model& model) {
+        size_t nr_indices = 0;
+        for (const Mesh& mesh : model.getMeshes())
+            nr_indices += mesh.indices.size();
+        return nr_indices > 30000;
+    };
+    bool test_object_heavy = isHeavy(test_object);
+
+    // Frame graph & render passes --------------------------------------------------------------
+    FrameGraph frame_graph;
+    DeferredRenderer deferred;
+    OutlinePass outline_pass;
+    PostProcessor post;
+    TemporalAA temporal_aa;
+    MandelbrotRenderer mandelbrot(256);
+    CpuMandelbrot cpu_mandelbrot;
+    MandelbrotDifference cpu_difference;
+    bool cpu_compared = false;
+
+    // Directional light shadows, chess board and grass are cached as static casters
+    CascadedShadowMap shadows;
+    std::vector<unsigned int> shadow_casters;
+    int nr_cascades = shadows.getCascadeCount(), shadow_resolution = 2;
+
+    // Fragments passing the depth test in the main scene pass
+    GpuCounter fragment_counter(GL_SAMPLES_PASSED);
+
+    // GPU time of the scene and post-processing, it drives the render resolution
+    GpuCounter frame_timer(GL_TIME_ELAPSED);
+    DynamicResolution dynamic_resolution;
 
     // Enable buffer-based effects and optimizations --------------------------------------------
     glEnable(GL_STENCIL_TEST);
     glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+    glStencilFunc(GL_ALWAYS, 1, 0xFF);
     glEnable(GL_CULL_FACE);
 
     // Render loop state ------------------------------------------------------------------------
-    glm::vec4 clear_color(0.0f);
-    float scale = 1.0f, dt = 0.0f, last_frame = 0.0f;
-    int active_shader_type = 0, culling = 2, polygon_mode = 0, prev_poly_mode = polygon_mode;
+    glm::vec4 clear_color(0.0f), outline_color(0.7f, 0.7f, 0.7f, 1.0f);
+    float scale = 1.0f, outline_width = 4.0f, blur_sigma = 2.0f, sharpen_strength = 1.0f, upscale_sharpness = 0.2f, upsampling_scale = 0.67f, filter_stride = 1.0f, exposure = 1.0f, gamma = 1.0f, prev_scale = 0.0f, dt = 0.0f, last_frame = 0.0f;
+    int active_shader_type = 0, renderer = 0, anti_aliasing = 0, prev_anti_aliasing = anti_aliasing, post_filter = 0, culling = 2, polygon_mode = 0, prev_poly_mode = polygon_mode, fractal_resolution = 0;
     bool vsync = true,
+        show_fractal = true,
+        animate_fractal = false,
+        occlusion_culling = true,
+        show_occlusion_buffer = false,
+        use_occlusion_queries = true,
         render_outline = false,
-        render_grass = true;
+        render_grass = true,
+        animate_cluster_lights = true,
+        depth_prepass = false,
+        shadows_enabled = true,
+        animate_dir_light = true,
+        count_fragments = false,
+        pipelined_simulation = false,
+        post_grayscale = false,
+        post_invert = false;
+    // Owns the camera and the light animation while pipelined
+    std::unique_ptr<Simulation> simulation;
 
     while (!glfwWindowShouldClose(window)) {
         // Update scene state -------------------------------------------------------------------
@@ -181,6 +425,20 @@ int main() {
         dt = current_frame - last_frame;
         last_frame = current_frame;
 
+        UniformStats uniform_stats = Shader::getUniformStats();
+        Shader::resetUniformStats();
+
+        if (persistent_streaming != prev_persistent_streaming) {
+            frame_stream = std::make_unique<StreamBuffer>(4 << 20, persistent_streaming);
+            prev_persistent_streaming = persistent_streaming;
+        }
+        frame_stream->beginFrame();
+
+        JobStats job_stats = jobs.collectStats();
+        jobs.runMainJobs();
+        if (trace_frames > 0 && --trace_frames == 0)
+            jobs.endTrace("job_trace.json");
+
         WindowState state = controller::getState();
         {
             if (!io.WantCaptureMouse) {
@@ -189,8 +447,73 @@ int main() {
                     setVisibility(*point_light, state.distance);
                 setVisibility(spot_light, state.distance);
             }
-            //if (state.framesize_changed)
-                //target.updateRenderShape(state.scr_width, state.scr_height);
+        }
+
+        // Pipelined Simulation -----------------------------------------------------------------
+        // Input is still polled here, the simulation thread integrates it and the frame renders its latest snapshot.
+        // Respawned cluster lights restart the thread, stopping it hands the camera back to the input controller.
+        const SceneSnapshot* snapshot = nullptr;
+        {
+            if (simulation && (!pipelined_simulation || simulation->getOrbitCount() != cluster_orbits.size())) {
+                camera = simulation->getLatest().camera;
+                camera.refocus = true;
+                simulation.reset();
+                controller::setCamera(&camera);
+            }
+
+            if (pipelined_simulation) {
+                SimulationInput input;
+                const KeyBind* movement_keys[] = { &bindings.key_w, &bindings.key_s, &bindings.key_a, &bindings.key_d, &bindings.key_space, &bindings.key_lctrl };
+                for (unsigned int m = 0; m < 6; m++) {
+                    if (movement_keys[m]->down())
+                        input.movement |= 1u << m;
+                }
+                glfwGetCursorPos(window, &input.cursor_x, &input.cursor_y);
+                WindowState input_state = controller::getState();
+                input.scroll = input_state.scroll;
+                input.capture = input_state.capture_controller && !io.WantCaptureMouse;
+                input.animate_dir_light = animate_dir_light;
+                input.animate_cluster_lights = animate_cluster_lights;
+
+                if (!simulation) {
+                    SceneSnapshot initial;
+                    initial.time = glfwGetTime();
+                    initial.camera = camera;
+                    initial.dir_light_dir = dir_light.dir;
+                    for (size_t i = nr_lights; i < cluster_lights.size(); i++)
+                        initial.cluster_light_positions.push_back(cluster_lights[i]->pos);
+                    simulation = std::make_unique<Simulation>(initial, input, cluster_orbits);
+                    controller::setCamera(nullptr);
+                }
+                simulation->setInput(input);
+
+                snapshot = &simulation->getLatest();
+                camera = snapshot->camera;
+                if (dir_light.dir != snapshot->dir_light_dir) {
+                    dir_light.dir = snapshot->dir_light_dir;
+                    dir_light.markDirty();
+                }
+            }
+        }
+        // --------------------------------------------------------------------------------------
+
+        // Start CPU culling work so it overlaps GUI building and the previous frame's GPU work --
+        float aspect = (float)state.scr_width / (float)state.scr_height;
+        glm::uvec2 window_size(std::max(state.scr_width, 1u), std::max(state.scr_height, 1u));
+        dynamic_resolution.update(frame_timer.getResult() / 1e6f);
+        glm::uvec2 render_size = dynamic_resolution.getSize(window_size, anti_aliasing == 2 ? upsampling_scale : 1.0f);
+        glm::mat4 proj = glm::perspective(glm::radians(camera.zoom), aspect, 0.1f, 100.0f);
+        glm::mat4 view = camera.getViewMatrix();
+        {
+            if (scale != prev_scale) {
+                test_object_model = glm::scale(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.7f, 0.0f)), glm::vec3(scale));
+                scene_bvh.update(object_proxies[test_object_id], test_object.getBounds().transform(test_object_model));
+                test_object_occluder.model = test_object_model;
+                prev_scale = scale;
+            }
+
+            if (occlusion_culling)
+                occlusion_culler.begin(proj * view, occluders);
         }
 
         // GUI --------------------------------------------------------------------------------------
@@ -212,11 +535,20 @@ int main() {
             ImGui::SliderFloat("Scale", &scale, 0.1f, 10.0);
 
             ImGui::Checkbox("Render outline", &render_outline); ImGui::SameLine();
-            ImGui::Checkbox("Render grass", &render_grass);
+            if (ImGui::Checkbox("Render grass", &render_grass))
+                shadows.invalidate();
+            if (render_outline) {
+                ImGui::SliderFloat("Outline width", &outline_width, 1.0f, 32.0f);
+                ImGui::ColorEdit4("Outline color", (float*)&outline_color);
+            }
 
             ImGui::RadioButton("Phong", &active_shader_type, 0); ImGui::SameLine();
             ImGui::RadioButton("Depth", &active_shader_type, 1); ImGui::SameLine();
-            ImGui::RadioButton("Normal", &active_shader_type, 2);
+            ImGui::RadioButton("Normal", &active_shader_type, 2); ImGui::SameLine();
+            ImGui::RadioButton("Clustered", &active_shader_type, 3);
+
+            ImGui::RadioButton("Forward", &renderer, 0); ImGui::SameLine();
+            ImGui::RadioButton("Deferred", &renderer, 1);
 
             switch (active_shader_type)
             {
@@ -230,6 +562,9 @@ int main() {
                 active_shader = &normal_shader;
                 glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.cubemap_texture);
                 break;
+            case 3:
+                active_shader = &clustered_shader;
+                break;
             default:
                 break;
             }
@@ -288,134 +623,574 @@ int main() {
             glfwSwapInterval(vsync);
 
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+            ImGui::Text("Uniform uploads: %u issued, %u skipped", uniform_stats.issued, uniform_stats.skipped);
+            {
+                const StreamStats& stats = frame_stream->getStats();
+                ImGui::Text("Stream buffer (%s): %.1f KB in %u ranges, %u overflowed, waited %.3f ms", frame_stream->isPersistent() ? "persistent" : "orphaned",
+                    stats.bytes / 1024.0f, stats.allocations, stats.overflows, stats.wait_ms);
+                // Recreated at the start of the next frame so this frame's ranges stay valid
+                ImGui::Checkbox("Persistent mapping", &persistent_streaming);
+            }
+            // Passes count meshes, the hierarchy counts whole objects
+            ImGui::Text("Scene BVH: %zu of %zu objects in the frustum", visible_objects.size(), scene_bvh.size());
+            for (const FrustumCuller* pass : cull_passes) {
+                const CullStats& stats = pass->getStats();
+                ImGui::Text("%s pass: %u visible, %u culled", pass->pass_name.c_str(), stats.visible, stats.culled);
+            }
+            ImGui::Text("Jobs: %u on %d threads, %u stolen, %u on the main lane", job_stats.jobs, jobs.getThreadCount(), job_stats.stolen, job_stats.main_jobs);
+            ImGui::SameLine();
+            if (ImGui::Button("Capture job trace") && !jobs.isTracing()) {
+                // Written to job_trace.json after 30 frames, for chrome://tracing or ui.perfetto.dev
+                jobs.beginTrace();
+                trace_frames = 30;
+            }
+            ImGui::Checkbox("Pipelined simulation", &pipelined_simulation);
+            if (snapshot) {
+                ImGui::SameLine();
+                ImGui::Text("Tick %llu at %.0f Hz, snapshot %.1f ms old", static_cast<unsigned long long>(snapshot->tick),
+                    simulation->getTickRate(), (glfwGetTime() - snapshot->time) * 1000.0);
+            }
+            ImGui::Checkbox("Indirect benchmark", &show_benchmark);
+            if (show_benchmark) {
+                ImGui::SameLine();
+                if (IndirectScene::isSupported())
+                    ImGui::Checkbox("Multi-draw indirect", &benchmark.use_indirect);
+                else
+                    ImGui::Text("(GL 4.3 needed for multi-draw indirect)");
+                if (IndirectScene::isSupported() && benchmark.use_indirect) {
+                    ImGui::Checkbox("GPU culling", &benchmark.gpu_culling); ImGui::SameLine();
+                    ImGui::Checkbox("Hi-Z occlusion", &benchmark.hiz_occlusion); ImGui::SameLine();
+                }
+                ImGui::Checkbox("Animate benchmark", &animate_benchmark);
+                // Respawning a million objects takes a while, so only once the slider is let go
+                ImGui::SliderInt("Benchmark objects", &nr_benchmark_objects, 1000, 1000000, "%d", ImGuiSliderFlags_Logarithmic);
+                if (ImGui::IsItemDeactivatedAfterEdit())
+                    spawnBenchmark(nr_benchmark_objects);
+                const IndirectStats& stats = benchmark.getStats();
+                ImGui::Text("Benchmark: %u objects in %u draw calls (%s), submitted in %.3f ms%s", stats.objects, stats.draw_calls,
+                    stats.indirect ? "indirect" : "one per object", stats.submit_ms, renderer == 1 ? ", forward renderer only" : "");
+                if (stats.gpu_culled)
+                    ImGui::Text("GPU culling: %u of %u objects visible, %.1f KB of transforms uploaded", stats.visible, stats.objects, stats.uploaded / 1024.0f);
+            }
+            ImGui::Checkbox("Record draws on worker threads", &scene_draws.parallel);
+            prepass_draws.parallel = scene_draws.parallel;
+            {
+                const DrawListStats& stats = scene_draws.getStats();
+                ImGui::Text("Scene draw list: %u packets, %u program, %u material and %u VAO changes, recorded in %.3f ms",
+                    stats.packets, stats.program_changes, stats.material_changes, stats.vao_changes, stats.record_ms);
+            }
+
+            ImGui::Checkbox("Occlusion culling", &occlusion_culling); ImGui::SameLine();
+            ImGui::Checkbox("Show occlusion buffer", &show_occlusion_buffer);
+            if (occlusion_culling) {
+                const CullStats& stats = occlusion_culler.getStats();
+                ImGui::Text("Occlusion: %u visible, %u culled", stats.visible, stats.culled);
+                if (show_occlusion_buffer && occlusion_debug_texture)
+                    ImGui::Image((ImTextureID)(intptr_t)occlusion_debug_texture,
+                        ImVec2((float)occlusion_culler.width, (float)occlusion_culler.height), ImVec2(0, 1), ImVec2(1, 0));
+            }
+
+            ImGui::Checkbox("Occlusion queries", &use_occlusion_queries); ImGui::SameLine();
+            ImGui::Checkbox("Conditional rendering", &occlusion_queries.conditional_render);
+            ImGui::SliderInt("Re-test interval", &occlusion_queries.retest_interval, 1, 30);
+            if (use_occlusion_queries) {
+                const OcclusionQueryStats& stats = occlusion_queries.getStats();
+                ImGui::Text("Occlusion queries: %u issued, %u draws skipped, %u conditional", stats.queries, stats.skipped, stats.conditional);
+            }
+
+            if (active_shader_type == 3 || renderer == 1) {
+                if (ImGui::SliderInt("Clustered lights", &nr_cluster_lights, nr_lights, 4096))
+                    spawnClusterLights(nr_cluster_lights);
+                ImGui::Checkbox("Animate lights", &animate_cluster_lights);
+                unsigned int nr_clusters = light_clusters.dims.x * light_clusters.dims.y * light_clusters.dims.z;
+                if (renderer == 0)
+                    ImGui::Text("Clusters: %u lights, %zu light indices (%.2f per cluster)", light_clusters.getLightCount(),
+                        light_clusters.getIndexCount(), light_clusters.getIndexCount() / (float)nr_clusters);
+            }
+
+            ImGui::Checkbox("Shadows", &shadows_enabled); ImGui::SameLine();
+            ImGui::Checkbox("Animate light", &animate_dir_light);
+            if (shadows_enabled) {
+                ImGui::SliderInt("Cascades", &nr_cascades, 1, MAX_CASCADES);
+                ImGui::Combo("Shadow resolution", &shadow_resolution, "512\0" "1024\0" "2048\0" "4096\0");
+                ImGui::SliderFloat("Shadow update threshold", &shadows.update_threshold, 0.0f, 10.0f, "%.1f deg");
+                const ShadowStats& stats = shadows.getStats();
+                ImGui::Text("Shadow casters: %u static cascade renders, %u dynamic", stats.static_renders, stats.dynamic_renders);
+                for (int c = 0; c < shadows.getCascadeCount(); c++) {
+                    const CullStats& cull_stats = shadows.getCuller(c).getStats();
+                    ImGui::Text("Cascade %d: %u visible, %u culled", c, cull_stats.visible, cull_stats.culled);
+                }
+            }
+
+            ImGui::Checkbox("Depth pre-pass", &depth_prepass); ImGui::SameLine();
+            ImGui::Checkbox("Count shaded fragments", &count_fragments);
+            if (depth_prepass)
+                ImGui::Text("Pre-pass vertex data: %.1f KB instead of %.1f KB", position_bytes / 1024.0f, vertex_bytes / 1024.0f);
+            if (count_fragments) {
+                GLuint64 fragments = fragment_counter.getResult();
+                ImGui::Text("Shaded fragments: %llu (%.2f per pixel)", (unsigned long long)fragments, fragments / (double(render_size.x) * render_size.y));
+            }
+
+            ImGui::Checkbox("Dynamic resolution", &dynamic_resolution.enabled);
+            if (dynamic_resolution.enabled) {
+                ImGui::SliderFloat("Target GPU time (ms)", &dynamic_resolution.target_ms, 2.0f, 50.0f);
+                ImGui::SliderFloat("Min scale", &dynamic_resolution.min_scale, 0.25f, dynamic_resolution.max_scale);
+                ImGui::SliderFloat("Max scale", &dynamic_resolution.max_scale, dynamic_resolution.min_scale, 2.0f);
+                ImGui::SliderFloat("Upscale sharpness", &upscale_sharpness, 0.0f, 1.0f);
+            }
+            ImGui::Combo("Anti-aliasing", &anti_aliasing, "Off\0" "TAA\0" "TAA upsampling\0");
+            if (anti_aliasing == 2)
+                ImGui::SliderFloat("Upsampling scale", &upsampling_scale, 0.5f, 0.75f);
+            if (anti_aliasing)
+                ImGui::SliderFloat("History feedback", &temporal_aa.feedback, 0.5f, 0.98f);
+            ImGui::Text("Render resolution: %ux%u (%.0f%%), GPU %.2f ms", render_size.x, render_size.y,
+                dynamic_resolution.getScale() * 100.0f, frame_timer.getResult() / 1e6f);
+
+            ImGui::Checkbox("Fractal", &show_fractal);
+            if (show_fractal) {
+                ImGui::SameLine();
+                ImGui::Checkbox("Animate fractal", &animate_fractal);
+                MandelbrotView& fractal_view = mandelbrot.view;
+                // The center is fixed point, so it is moved by pixels instead of edited directly
+                glm::vec2 pan(0.0f);
+                if (ImGui::DragFloat2("Fractal pan (pixels)", &pan.x, 0.5f)) {
+                    fractal_view.center_x = fractal_view.center_x + FixedPoint(pan.x * mandelbrot.getPixelSize());
+                    fractal_view.center_y = fractal_view.center_y + FixedPoint(pan.y * mandelbrot.getPixelSize());
+                }
+                const double min_zoom = 1.0, max_zoom = 1e80;
+                ImGui::SliderScalar("Fractal zoom", ImGuiDataType_Double, &fractal_view.zoom, &min_zoom, &max_zoom, "%.3g", ImGuiSliderFlags_Logarithmic);
+                if (ImGui::Button("Deep zoom target")) {
+                    // c = i is a Misiurewicz point, its neighborhood keeps showing detail at any zoom
+                    fractal_view.center_x = FixedPoint(0.0);
+                    fractal_view.center_y = FixedPoint(1.0);
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Reset fractal"))
+                    fractal_view = MandelbrotView();
+                int digits = static_cast<int>(std::log10(fractal_view.zoom)) + 6;
+                ImGui::Text("Center: %s", fractal_view.center_x.toString(digits).c_str());
+                ImGui::Text("        %s i", fractal_view.center_y.toString(digits).c_str());
+                ImGui::SliderInt("Max iterations", &fractal_view.max_iterations, 100, 10000);
+                ImGui::Combo("Fractal resolution", &fractal_resolution, "256\0" "512\0" "1024\0");
+                ImGui::SliderFloat("Tile budget (ms)", &mandelbrot.budget_ms, 0.25f, 8.0f);
+                const MandelbrotStats& stats = mandelbrot.getStats();
+                ImGui::Text("Fractal tiles: %u of %u pending, %u rendered, %u reused, %.2f ms per batch", stats.pending, stats.tiles,
+                    stats.rendered, stats.reused, mandelbrot.getTileTime());
+                if (stats.perturbation)
+                    ImGui::Text("Perturbation: %u reference iterations, %u skipped by the series", stats.reference_iterations, stats.skipped);
+
+                if (ImGui::Button("CPU reference")) {
+                    unsigned int size = mandelbrot.getSize();
+                    std::vector<float> cpu_iterations = cpu_mandelbrot.render(fractal_view, size);
+                    CpuMandelbrot::writePng("mandelbrot_cpu.png", CpuMandelbrot::colorize(cpu_iterations, size), size, size);
+
+                    // Only the single precision path computes the same thing, and only a finished cache is comparable
+                    cpu_compared = !stats.perturbation && stats.pending == 0;
+                    if (cpu_compared) {
+                        std::vector<float> gpu_iterations(size * size);
+                        glBindTexture(GL_TEXTURE_2D, mandelbrot.getTexture());
+                        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, gpu_iterations.data());
+                        glBindTexture(GL_TEXTURE_2D, 0);
+                        cpu_difference = CpuMandelbrot::compare(cpu_iterations, gpu_iterations);
+                    }
+                }
+                const CpuMandelbrotStats& cpu_stats = cpu_mandelbrot.getStats();
+                if (cpu_stats.tiles > 0) {
+                    ImGui::SameLine();
+                    ImGui::Text("%.1f ms, %.1f Mpix/s, %u tiles on %u threads", cpu_stats.ms, cpu_stats.mpix_per_s, cpu_stats.tiles, cpu_stats.threads);
+                    ImGui::Text("CPU skipped %u pixels analytically, %u as periodic", cpu_stats.analytic, cpu_stats.periodic);
+                }
+                if (cpu_compared)
+                    ImGui::Text("GPU cache vs CPU: %u pixels differ, max error %.3f", cpu_difference.mismatched, cpu_difference.max_error);
+            }
+
+            ImGui::Combo("Post filter", &post_filter, "None\0" "Binomial blur\0" "Gaussian blur\0" "Sharpen\0" "Edges\0");
+            if (post_filter == 2)
+                ImGui::SliderFloat("Blur sigma", &blur_sigma, 0.5f, 16.0f);
+            if (post_filter >= 3)
+                ImGui::SliderFloat("Filter strength", &sharpen_strength, 0.0f, 4.0f);
+            if (post_filter)
+                ImGui::SliderFloat("Filter stride", &filter_stride, 0.5f, 4.0f);
+            ImGui::Checkbox("Grayscale", &post_grayscale); ImGui::SameLine();
+            ImGui::Checkbox("Invert", &post_invert);
+            ImGui::SliderFloat("Exposure", &exposure, 0.1f, 4.0f);
+            ImGui::SliderFloat("Gamma", &gamma, 0.5f, 3.0f);
+            {
+                const PostStats& stats = post.getStats();
+                ImGui::Text("Post-processing: %u passes, %u taps per pixel, %zu programs cached", stats.passes, stats.taps, post.getProgramCount());
+            }
+            {
+                const FrameGraphStats& stats = frame_graph.getStats();
+                ImGui::Text("Frame graph: %u passes, %u culled", stats.passes, stats.culled);
+                ImGui::Text("Render targets: %.1f MB in %u textures (%.1f MB without aliasing, %.1f MB pooled)",
+                    stats.bytes / 1048576.0f, stats.physical_textures, stats.unaliased_bytes / 1048576.0f, stats.pool_bytes / 1048576.0f);
+            }
+
+            RayHit hit;
+            if (scene_bvh.raycast({ camera.pos, camera.getFront() }, 100.0f, hit))
+                ImGui::Text("Looking at: %s (%.2f)", object_names[hit.user_data].c_str(), hit.t);
+
+            if (ImGui::Button("Run culling benchmark"))
+                culling_benchmark = benchmarkCulling({ 100, 1000, 10000, 100000 });
+            for (const CullingBenchmark& result : culling_benchmark)
+                ImGui::Text("%zu objects: brute force %.3f ms, BVH %.3f ms", result.nr_objects, result.brute_force_ms, result.bvh_ms);
             ImGui::End();
             ImGui::Render();
         }
 
         // Set-up next frame and render all objects for target1 ------------------------------------
         {
-            float aspect = (float)state.scr_width / (float)state.scr_height;
-            glm::mat4 proj = glm::perspective(glm::radians(camera.zoom), aspect, 0.1f, 100.0f);
-            glm::mat4 view = camera.getViewMatrix();
+            scene_culler.begin(proj * view);
+            visible_objects.clear();
+            scene_bvh.cull(scene_culler.getFrustum(), visible_objects);
+            std::fill(object_visible.begin(), object_visible.end(), 0);
+            for (unsigned int id : visible_objects)
+                object_visible[id] = 1;
+
+            if (occlusion_culling) {
+                occlusion_culler.wait();
+                for (unsigned int id : visible_objects)
+                    object_visible[id] = occlusion_culler.test(scene_bvh.getBounds(object_proxies[id]));
+                if (show_occlusion_buffer)
+                    occlusion_debug_texture = occlusion_culler.updateDebugTexture();
+            }
+            occlusion_queries.begin(proj, view, camera.pos);
 
-            {
-                target.use();
-                glClearColor(clear_color.x, clear_color.y, clear_color.z, 1.0f);
-                glEnable(GL_DEPTH_TEST);
-                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            // The deferred path draws the same scene with the G-buffer program
+            Shader* scene_shader = renderer == 1 ? &deferred.geometry_shader : active_shader;
+
+            // The fractal cache persists across frames, so it is refined outside of the frame graph and the timing
+            if (show_fractal) {
+                mandelbrot.resize(256 << fractal_resolution);
+                mandelbrot.update();
+            }
 
-                active_shader->use();
-                active_shader->setMat4("proj", proj);
-                active_shader->setMat4("view", view);
+            frame_timer.begin();
 
+            // Cascaded Shadow Maps -----------------------------------------------------------------
+            if (animate_dir_light && !snapshot) {
                 dir_light.dir = glm::vec4(sin(current_frame), -1.0f, cos(current_frame), 0.0f);
-                updateMaterialShader(*active_shader, lights);
+                dir_light.markDirty();
             }
 
-            glViewport(0, 0, ires.x, ires.y);
-            {
-                // Render Chessboard --------------------------------------------------------------------
-                {
-                    glm::mat4 model(1.0f);
-                    model = glm::translate(model, glm::vec3(0.0f, -0.3f, 0.0f));
-
-                    glStencilMask(0x00);
-                    active_shader->setMat4("model", model);
+            if (shadows_enabled) {
+                shadows.configure(nr_cascades, 512 << shadow_resolution);
+                shadows.update(view, glm::radians(camera.zoom), aspect, 0.1f, glm::vec3(dir_light.dir));
+
+                for (int c = 0; c < shadows.getCascadeCount(); c++) {
+                    FrustumCuller& culler = shadows.getCuller(c);
+                    shadow_casters.clear();
+                    scene_bvh.cull(culler.getFrustum(), shadow_casters);
+
+                    bindCameraBlock(*frame_stream, shadows.getLightMatrix(c), glm::mat4(1.0f));
+
+                    // Static casters are only redrawn when the cascade's cache is stale
+                    if (shadows.beginStatic(c)) {
+                        for (unsigned int id : shadow_casters) {
+                            if (id == chess_board_id)
+                                chess_board.drawPositions(prepass_shader, chess_board_model, culler);
+                            else if (render_grass && id >= first_grass_id && id < first_grass_id + nr_grass) {
+                                prepass_alpha_shader.use();
+                                prepass_alpha_shader.setMat4("model", grass_models[id - first_grass_id]);
+                                grass.draw(prepass_alpha_shader);
+                            }
+                        }
+                    }
 
-                    chess_board.draw(*active_shader, state.mesh);
+                    shadows.beginDynamic(c);
+                    for (unsigned int id : shadow_casters) {
+                        if (id == test_object_id)
+                            test_object.drawPositions(prepass_shader, test_object_model, culler);
+                    }
                 }
-                // --------------------------------------------------------------------------------------
-
-                // Billboard Grass ----------------------------------------------------------------------
-                for (int i = 0; render_grass && i < nr_grass; i++) {
-                    glm::mat4 model(1.0f);
-                    model = glm::translate(model, glm::vec3(dist[i].x, 0.7f, dist[i].y));
-                    model = glm::rotate(model, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-                    active_shader->setMat4("model", model);
-                    grass.draw(*active_shader, state.mesh);
+                shadows.end();
+            }
+            // --------------------------------------------------------------------------------------
+
+            // Frame Graph --------------------------------------------------------------------------
+            // Everything but the cached shadow maps is declared per frame at the window's resolution. The scene
+            // renders with a jittered projection when temporally anti-aliased, culling keeps the unjittered one.
+            glm::mat4 unjittered_proj = proj;
+            if (anti_aliasing)
+                proj = temporal_aa.jitter(proj, render_size, window_size);
+            frame_graph.reset();
+            FrameResource backbuffer = frame_graph.importBackbuffer(window_size.x, window_size.y);
+            FrameResource scene_color = frame_graph.create("Scene color", { render_size.x, render_size.y, GL_RGB8 });
+            FrameResource scene_depth = frame_graph.create("Scene depth", { render_size.x, render_size.y, GL_DEPTH24_STENCIL8 });
+            GBuffer gbuffer{};
+            if (renderer == 1)
+                gbuffer = GBuffer::create(frame_graph, render_size.x, render_size.y);
+            // --------------------------------------------------------------------------------------
+
+            // Scene --------------------------------------------------------------------------------
+            // The deferred path draws the same scene into the G-buffer
+            FrameGraph::Builder scene_pass = frame_graph.addPass(renderer == 1 ? "G-buffer" : "Scene", [&](FrameGraph&) {
+                if ((active_shader_type == 3 || renderer == 1) && snapshot) {
+                    const std::vector<glm::vec4>& positions = snapshot->cluster_light_positions;
+                    for (size_t i = 0; i < positions.size(); i++)
+                        cluster_lights[nr_lights + i]->pos = positions[i];
+                }
+                else if ((active_shader_type == 3 || renderer == 1) && animate_cluster_lights) {
+                    // A few thousand orbits at most, cheaper than handing them to the job system
+                    for (size_t i = 0; i < cluster_orbits.size(); i++) {
+                        const glm::vec3& orbit = cluster_orbits[i];
+                        float angle = orbit.y + current_frame * 2.0f / (1.0f + orbit.x);
+                        cluster_lights[nr_lights + i]->pos = glm::vec4(orbit.x * glm::cos(angle), orbit.z, orbit.x * glm::sin(angle), 1.0f);
+                    }
                 }
-                // --------------------------------------------------------------------------------------
-
-                // Test Object --------------------------------------------------------------------------
-                {
-                    glStencilMask(0xFF);
-
-                    glm::mat4 model(1.0f);
-                    model = glm::translate(model, glm::vec3(0.0f, 0.7f, 0.0f));
-                    model = glm::scale(model, glm::vec3(scale));
 
-                    active_shader->setMat4("model", model);
+                // Also read by the depth pre-pass
+                bindCameraBlock(*frame_stream, proj, view);
+                if (renderer == 1)
+                    deferred.beginGeometry();
+                else {
+                    glClearColor(clear_color.x, clear_color.y, clear_color.z, 1.0f);
+                    glEnable(GL_DEPTH_TEST);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+                    active_shader->use();
+
+                    if (active_shader_type == 3) {
+                        light_clusters.update(cluster_lights, view, glm::radians(camera.zoom), aspect, 0.1f, 100.0f);
+                        light_clusters.bind(*active_shader, glm::vec2(render_size));
+                        updateMaterialShader(*active_shader, clustered_lights);
+                    }
+                    else
+                        updateMaterialShader(*active_shader, lights);
 
-                    test_object.draw(*active_shader, state.mesh);
+                    if (active_shader_type == 0 || active_shader_type == 3)
+                        shadows.bind(*active_shader, shadows_enabled);
+                }
 
-                    if (render_outline) {
-                        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-                        glDisable(GL_DEPTH_TEST);
-                        glStencilMask(0x00);
+                // Depth Pre-pass -----------------------------------------------------------------------
+                // Lays down the final depth with cheap programs so the main pass only shades visible fragments
+                bool prepass = depth_prepass && renderer == 0;
+                if (prepass) {
+                    prepass_culler.begin(proj * view);
+                    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+                    glStencilMask(0x00);
 
-                        model = glm::scale(model, glm::vec3(1.05f, 1.05f, 1.05f));
+                    // Grass is alpha tested, so it needs the texture lookup
+                    const Frustum& frustum = prepass_culler.getFrustum();
+                    prepass_draws.record(2 + nr_grass, [&](DrawRecorder& recorder, unsigned int i) {
+                        if (i == 0 && object_visible[chess_board_id])
+                            chess_board.record(recorder, prepass_shader, chess_board_model, &frustum, true, state.mesh);
+                        else if (i == 1 && object_visible[test_object_id])
+                            test_object.record(recorder, prepass_shader, test_object_model, &frustum, true, state.mesh);
+                        else if (i >= 2 && render_grass && object_visible[first_grass_id + i - 2])
+                            grass.record(recorder, prepass_alpha_shader, grass_models[i - 2], nullptr, false, state.mesh);
+                    });
+                    prepass_draws.submit(&prepass_culler);
+
+                    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+                    glDepthFunc(GL_EQUAL);
+                    glDepthMask(GL_FALSE);
+                    scene_shader->use();
+                }
+                // --------------------------------------------------------------------------------------
 
-                        outline_shader.use();
+                if (count_fragments)
+                    fragment_counter.begin();
+                // Chessboard & Billboard Grass ---------------------------------------------------------
+                // Recorded on worker threads, neither writes stencil
+                glStencilMask(0x00);
+                const Frustum& frustum = scene_culler.getFrustum();
+                scene_draws.record(1 + nr_grass, [&](DrawRecorder& recorder, unsigned int i) {
+                    if (i == 0 && object_visible[chess_board_id])
+                        chess_board.record(recorder, *scene_shader, chess_board_model, &frustum, false, state.mesh);
+                    else if (i >= 1 && render_grass && object_visible[first_grass_id + i - 1])
+                        grass.record(recorder, *scene_shader, grass_models[i - 1], nullptr, false, state.mesh);
+                });
+                scene_draws.submit(&scene_culler);
+                // --------------------------------------------------------------------------------------
 
-                        outline_shader.setMat4("proj", proj);
-                        outline_shader.setMat4("view", view);
-                        outline_shader.setMat4("model", model);
+                // Test Object --------------------------------------------------------------------------
+                glStencilMask(0xFF);
+                if (object_visible[test_object_id]) {
+                    // Only one samples query can be active at a time
+                    bool query = use_occlusion_queries && test_object_heavy && !count_fragments;
+                    if (!query || occlusion_queries.beginDraw(test_object_id, scene_bvh.getBounds(object_proxies[test_object_id]))) {
+                        test_object.draw(*scene_shader, test_object_model, scene_culler, state.mesh);
+                        if (query)
+                            occlusion_queries.endDraw();
+                    }
+                }
+                // --------------------------------------------------------------------------------------
 
-                        test_object.draw(outline_shader, state.mesh);
+                if (count_fragments)
+                    fragment_counter.end();
+                if (prepass) {
+                    glDepthFunc(GL_LESS);
+                    glDepthMask(GL_TRUE);
+                }
 
-                        glEnable(GL_DEPTH_TEST);
-                        glStencilMask(0xFF);
-                        glStencilFunc(GL_ALWAYS, 1, 0xFF);
+                // Indirect Benchmark -------------------------------------------------------------------
+                // Not part of the pre-pass or the G-buffer layout, so forward and after the pre-pass depth test
+                if (show_benchmark && renderer == 0) {
+                    // A contiguous block of objects, so the upload stays one range
+                    if (animate_benchmark) {
+                        unsigned int nr_animated = static_cast<unsigned int>(std::min<size_t>(1000, benchmark.getObjectCount()));
+                        for (unsigned int i = 0; i < nr_animated; i++)
+                            benchmark.setTransform(i, glm::rotate(benchmark.getTransform(i), dt, glm::vec3(0.0f, 1.0f, 0.0f)));
                     }
+                    glStencilMask(0x00);
+                    benchmark.draw(glm::vec3(view * dir_light.dir), proj * view);
+                    glStencilMask(0xFF);
                 }
                 // --------------------------------------------------------------------------------------
+            });
+            if (renderer == 1)
+                DeferredRenderer::writeGBuffer(scene_pass, gbuffer);
+            else
+                scene_pass.write(scene_color).depthStencil(scene_depth);
+            // --------------------------------------------------------------------------------------
+
+            // Deferred Lighting --------------------------------------------------------------------
+            if (renderer == 1) {
+                FrameGraph::Builder resolve_pass = frame_graph.addPass("Deferred lighting", [&](FrameGraph& graph) {
+                    glClearColor(clear_color.x, clear_color.y, clear_color.z, 1.0f);
+                    glClear(GL_COLOR_BUFFER_BIT);
+                    shadows.bind(deferred.getDirectionalShader(), shadows_enabled);
+                    deferred.resolve(graph, gbuffer, proj, view, clustered_lights, cluster_lights, *frame_stream);
+                });
+                DeferredRenderer::resolveGBuffer(resolve_pass, gbuffer, scene_color, scene_depth);
+            }
+            // --------------------------------------------------------------------------------------
+
+            // Hi-Z ---------------------------------------------------------------------------------
+            // Occlusion pyramid of this frame's depth, the benchmark culls against it next frame
+            if (show_benchmark && renderer == 0 && IndirectScene::isSupported() && benchmark.gpu_culling && benchmark.hiz_occlusion) {
+                frame_graph.addPass("Hi-Z", [&](FrameGraph& graph) {
+                    benchmark.buildHiZ(graph.getTexture(scene_depth), render_size.x, render_size.y, proj * view);
+                }).read(scene_depth).sideEffect();
+            }
+            // --------------------------------------------------------------------------------------
 
-                // Lights -------------------------------------------------------------------------------
-                {
-                    light_source_shader.use();
+            // Outline ------------------------------------------------------------------------------
+            // The test object is the only geometry writing stencil, the passes outline the stencil mask
+            if (render_outline && object_visible[test_object_id])
+                outline_pass.addPasses(frame_graph, scene_color, scene_depth, outline_width * render_size.x / window_size.x, outline_color);
+            // --------------------------------------------------------------------------------------
 
-                    light_source_shader.setMat4("proj", proj);
-                    light_source_shader.setMat4("view", view);
+            // Lights & Skybox ----------------------------------------------------------------------
+            frame_graph.addPass("Lights & skybox", [&](FrameGraph&) {
+                light_source_shader.use();
 
-                    light_source_shader.setVec4("light_color", point_lights[0]->diffuse * 1e-1f * state.distance); // TODO Change heuristic constant
+                light_source_shader.setMat4("proj", proj);
+                light_source_shader.setMat4("view", view);
 
-                    for (auto& pos : point_light_positions) {
-                        glm::mat4 model(1.0f);
-                        model = glm::translate(model, pos);
-                        light_source_shader.setMat4("model", model);
-                        bulb.draw(light_source_shader);
-                    }
+                light_source_shader.setVec4("light_color", point_lights[0]->diffuse * 1e-1f * state.distance); // TODO Change heuristic constant
+
+                for (int i = 0; i < nr_lights; i++) {
+                    if (!object_visible[first_bulb_id + i])
+                        continue;
+                    glm::mat4 model(1.0f);
+                    model = glm::translate(model, point_light_positions[i]);
+                    bulb.draw(light_source_shader, model, scene_culler);
                 }
+                skybox.draw(proj, view);
+            }).write(scene_color).depthStencil(scene_depth);
+            // --------------------------------------------------------------------------------------
+
+            // Temporal Anti-aliasing ---------------------------------------------------------------
+            FrameResource scene_output = scene_color;
+            if (anti_aliasing) {
+                // History left from before the effect was switched off is stale
+                if (!prev_anti_aliasing)
+                    temporal_aa.reset();
+
+                scene_output = temporal_aa.addPasses(frame_graph, scene_color, scene_depth, window_size, proj, unjittered_proj, view, [&](Shader& velocity_shader) {
+                    velocity_culler.begin(unjittered_proj * view);
+                    if (object_visible[chess_board_id]) {
+                        temporal_aa.setModel(chess_board_model, chess_board_model);
+                        chess_board.drawPositions(velocity_shader, chess_board_model, velocity_culler, state.mesh);
+                    }
+                    if (object_visible[test_object_id]) {
+                        temporal_aa.setModel(test_object_model, prev_test_object_model);
+                        test_object.drawPositions(velocity_shader, test_object_model, velocity_culler, state.mesh);
+                    }
+
+                    velocity_shader.setBool("alpha_test", true);
+                    for (int i = 0; render_grass && i < nr_grass; i++) {
+                        if (!object_visible[first_grass_id + i])
+                            continue;
+                        temporal_aa.setModel(grass_models[i], grass_models[i]);
+                        grass.draw(velocity_shader, state.mesh);
+                    }
+                    velocity_shader.setBool("alpha_test", false);
+
+                    for (int i = 0; i < nr_lights; i++) {
+                        if (!object_visible[first_bulb_id + i])
+                            continue;
+                        glm::mat4 model = glm::translate(glm::mat4(1.0f), point_light_positions[i]);
+                        temporal_aa.setModel(model, model);
+                        bulb.draw(velocity_shader, model, velocity_culler);
+                    }
+                });
             }
-            skybox.draw(proj, view);
-        }
+            prev_anti_aliasing = anti_aliasing;
+            // --------------------------------------------------------------------------------------
 
-        mandel.use();
-        identity_shader.use();
-        glDisable(GL_DEPTH_TEST);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glEnable(GL_DEPTH_TEST);
-        // Render to target -------------------------------------------------------------------------
-        screen_shader.use();
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        glViewport(0, 0, state.scr_width, state.scr_height);
-        target.draw();
-        //mandelbrot_shader.use();
-        //mandelbrot_shader.setFloat("time", current_frame);
-        glViewport(0, 0, 256, 256);
-        mandel.draw();
+            // Post-processing ----------------------------------------------------------------------
+            post.clear();
+            switch (post_filter) {
+            case 1:
+                post.addKernel(getBinomialKernel(5), filter_stride);
+                break;
+            case 2:
+                post.addGaussianBlur(blur_sigma, filter_stride);
+                break;
+            case 3:
+                post.addKernel(getSharpenKernel(sharpen_strength), filter_stride);
+                break;
+            case 4:
+                post.addKernel(getSharpenKernel(sharpen_strength, true), filter_stride);
+                break;
+            default:
+                break;
+            }
+            // The last pass reads the scene at render resolution, so it upscales with bilinear taps and sharpens
+            if (render_size.x < window_size.x && upscale_sharpness > 0.0f)
+                post.addKernel(getSharpenKernel(upscale_sharpness));
+            if (exposure != 1.0f)
+                post.addPointwise(POST_EXPOSURE, glm::vec4(exposure));
+            if (post_grayscale)
+                post.addPointwise(POST_GRAYSCALE);
+            if (post_invert)
+                post.addPointwise(POST_INVERT);
+            if (gamma != 1.0f)
+                post.addPointwise(POST_GAMMA, glm::vec4(gamma));
+            post.addPasses(frame_graph, scene_output, backbuffer);
+            // --------------------------------------------------------------------------------------
+
+            // Mandelbrot ---------------------------------------------------------------------------
+            if (show_fractal) {
+                FrameResource fractal = frame_graph.importTexture("Mandelbrot iterations", mandelbrot.getTexture(),
+                    { mandelbrot.getSize(), mandelbrot.getSize(), GL_R32F });
+                frame_graph.addPass("Mandelbrot preview", [&](FrameGraph&) {
+                    glViewport(0, 0, mandelbrot.getSize(), mandelbrot.getSize());
+                    mandelbrot.draw(animate_fractal ? current_frame : 0.0f);
+                }).read(fractal).write(backbuffer);
+            }
+            // --------------------------------------------------------------------------------------
+
+            frame_graph.compile();
+            frame_graph.execute();
+            frame_timer.end();
+            prev_test_object_model = test_object_model;
+        }
 
         // New frame setup --------------------------------------------------------------------------
         {
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            frame_stream->endFrame();
             glfwSwapBuffers(window);
             glfwPollEvents();
         }
     }
 
-    for (auto& point_light : point_lights)
+    simulation.reset();
+    for (auto& point_light : cluster_lights)
         delete point_light;
 
     ImGui_ImplOpenGL3_Shutdown();
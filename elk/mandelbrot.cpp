@@ -0,0 +1,303 @@
+#include "mandelbrot.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+MandelbrotRenderer::MandelbrotRenderer(unsigned int size, unsigned int tile_size) :
+    iterate_shader("shaders/deferred.vert", "shaders/mandelbrot_iterate.frag"),
+    perturb_shader("shaders/deferred.vert", "shaders/mandelbrot_perturb.frag"),
+    reproject_shader("shaders/deferred.vert", "shaders/mandelbrot_reproject.frag"),
+    colorize_shader("shaders/deferred.vert", "shaders/mandelbrot.frag"),
+    size(0),
+    tile_size(tile_size),
+    tiles_x(0),
+    tile_timer(GL_TIME_ELAPSED)
+{
+    glGenVertexArrays(1, &empty_vao);
+    glGenFramebuffers(2, fbos);
+    resize(size);
+
+    glGenBuffers(1, &orbit_buffer);
+    glGenTextures(1, &orbit_texture);
+    glBindBuffer(GL_TEXTURE_BUFFER, orbit_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec2), NULL, GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, orbit_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, orbit_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+MandelbrotRenderer::~MandelbrotRenderer() {
+    glDeleteFramebuffers(2, fbos);
+    glDeleteTextures(2, textures);
+    glDeleteVertexArrays(1, &empty_vao);
+    glDeleteTextures(1, &orbit_texture);
+    glDeleteBuffers(1, &orbit_buffer);
+}
+
+void MandelbrotRenderer::resize(unsigned int new_size) {
+    if (new_size == size)
+        return;
+    size = new_size;
+    tiles_x = (size + tile_size - 1) / tile_size;
+
+    // Negative counts mark points inside the set, -2 ones that were not computed yet
+    GLfloat unknown[] = { -2.0f, 0.0f, 0.0f, 0.0f };
+    glDeleteTextures(2, textures);
+    glGenTextures(2, textures);
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, size, size, 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Mandelbrot cache framebuffer is not complete!" << std::endl;
+        glClearBufferfv(GL_COLOR, 0, unknown);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    cache_valid = false;
+    done.assign(tiles_x * tiles_x, false);
+    stats.tiles = tiles_x * tiles_x;
+}
+
+void MandelbrotRenderer::fillQueue() {
+    queue.clear();
+    for (unsigned int t = 0; t < done.size(); t++) {
+        if (!done[t])
+            queue.push_back(t);
+    }
+
+    // Farthest from the center first, so the center is rendered first
+    auto distance = [this](unsigned int t) {
+        glm::vec2 offset = glm::vec2(t % tiles_x, t / tiles_x) + 0.5f - 0.5f * tiles_x;
+        return glm::dot(offset, offset);
+    };
+    std::sort(queue.begin(), queue.end(), [&](unsigned int a, unsigned int b) {
+        return distance(a) > distance(b);
+    });
+}
+
+void MandelbrotRenderer::reproject() {
+    if (!cache_valid) {
+        done.assign(done.size(), false);
+        cached_view = view;
+        cache_valid = true;
+        fillQueue();
+        return;
+    }
+
+    // Pans snap to whole pixels, so the cache can be shifted instead of recomputed
+    double old_pixel = 2.24 / (cached_view.zoom * size);
+    bool shift = view.zoom == cached_view.zoom && view.max_iterations == cached_view.max_iterations;
+    glm::dvec2 moved((view.center_x - cached_view.center_x).toDouble(), (view.center_y - cached_view.center_y).toDouble());
+    moved /= old_pixel;
+    if (shift) {
+        moved = glm::round(moved);
+        view.center_x = cached_view.center_x + FixedPoint(moved.x * old_pixel);
+        view.center_y = cached_view.center_y + FixedPoint(moved.y * old_pixel);
+    }
+
+    // Pixel p of the new view lies at p * scale + offset in the cached one
+    double scale = getPixelSize() / old_pixel;
+    glm::dvec2 offset = moved + 0.5 * size * (1.0 - scale);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, fbos[1 - current]);
+    glViewport(0, 0, size, size);
+    reproject_shader.use();
+    reproject_shader.setInt("previous", 0);
+    reproject_shader.setFloat("scale", static_cast<float>(scale));
+    reproject_shader.setVec2("offset", glm::vec2(offset));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textures[current]);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    // A shifted tile stays finished if all cached tiles under its corners were, other tiles only show a preview
+    std::vector<bool> kept(done.size(), false);
+    if (shift) {
+        glm::ivec2 delta = glm::ivec2(glm::round(offset));
+        auto wasDone = [&](int x, int y) {
+            if (x < 0 || y < 0 || x >= static_cast<int>(size) || y >= static_cast<int>(size))
+                return false;
+            return static_cast<bool>(done[(y / tile_size) * tiles_x + x / tile_size]);
+        };
+        for (unsigned int t = 0; t < kept.size(); t++) {
+            int x0 = (t % tiles_x) * tile_size + delta.x, y0 = (t / tiles_x) * tile_size + delta.y;
+            int x1 = std::min(x0 + static_cast<int>(tile_size), static_cast<int>(size) + delta.x) - 1;
+            int y1 = std::min(y0 + static_cast<int>(tile_size), static_cast<int>(size) + delta.y) - 1;
+            kept[t] = wasDone(x0, y0) && wasDone(x1, y0) && wasDone(x0, y1) && wasDone(x1, y1);
+            stats.reused += kept[t];
+        }
+    }
+
+    current = 1 - current;
+    done = kept;
+    cached_view = view;
+    fillQueue();
+}
+
+void MandelbrotRenderer::computeReference() {
+    // Z_n+1 = Z_n^2 + C at the view center, the orbit ends where it escapes
+    orbit.assign(1, glm::dvec2(0.0));
+    FixedPoint x, y;
+    for (int n = 0; n < view.max_iterations; n++) {
+        FixedPoint xy = x * y;
+        x = x * x - y * y + view.center_x;
+        y = xy + xy + view.center_y;
+        orbit.push_back(glm::dvec2(x.toDouble(), y.toDouble()));
+        if (glm::dot(orbit.back(), orbit.back()) > 16.0)
+            break;
+    }
+
+    std::vector<glm::vec2> data(orbit.begin(), orbit.end());
+    glBindBuffer(GL_TEXTURE_BUFFER, orbit_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(glm::vec2), data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    reference_x = view.center_x;
+    reference_y = view.center_y;
+    reference_max_iterations = view.max_iterations;
+    stats.reference_iterations = static_cast<unsigned int>(orbit.size() - 1);
+}
+
+void MandelbrotRenderer::computeSeries() {
+    auto mul = [](const glm::dvec2& a, const glm::dvec2& b) {
+        return glm::dvec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+    };
+
+    // The offset after n iterations is about A_n dc + B_n dc^2 + C_n dc^3, which is used while the cubic term
+    // stays negligible against the linear one for the corner pixels
+    double radius = getPixelSize() * size * 0.7071;
+    glm::dvec2 a(0.0), b(0.0), c(0.0);
+    unsigned int skip = 0;
+    for (size_t n = 0; n + 2 < orbit.size(); n++) {
+        glm::dvec2 z2 = 2.0 * orbit[n];
+        glm::dvec2 next_a = mul(z2, a) + glm::dvec2(1.0, 0.0);
+        glm::dvec2 next_b = mul(z2, b) + mul(a, a);
+        glm::dvec2 next_c = mul(z2, c) + 2.0 * mul(a, b);
+        if (glm::length(next_c) * radius * radius > 1e-6 * glm::length(next_a))
+            break;
+        a = next_a;
+        b = next_b;
+        c = next_c;
+        skip = static_cast<unsigned int>(n + 1);
+    }
+    stats.skipped = skip;
+
+    glm::dvec2 coefficients[] = { a, b, c };
+    for (int i = 0; i < 3; i++) {
+        int exponent = 0;
+        std::frexp(std::max(std::abs(coefficients[i].x), std::abs(coefficients[i].y)), &exponent);
+        series[i] = glm::vec2(std::ldexp(coefficients[i].x, -exponent), std::ldexp(coefficients[i].y, -exponent));
+        series_exponents[i] = exponent;
+    }
+}
+
+void MandelbrotRenderer::update() {
+    GLint prev_viewport[4], prev_polygon_mode[2];
+    glGetIntegerv(GL_VIEWPORT, prev_viewport);
+    glGetIntegerv(GL_POLYGON_MODE, prev_polygon_mode);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glBindVertexArray(empty_vao);
+
+    if (!cache_valid || view != cached_view) {
+        reproject();
+        stats.perturbation = view.zoom >= perturbation_zoom;
+        if (stats.perturbation) {
+            if (reference_x != view.center_x || reference_y != view.center_y || reference_max_iterations != view.max_iterations)
+                computeReference();
+            computeSeries();
+        }
+        else
+            stats.skipped = 0;
+    }
+
+    if (!queue.empty()) {
+        // Tiles per frame follow the measured time of earlier batches
+        GLuint64 timing = tile_timer.getResult();
+        if (timing != last_timing && timing > 0) {
+            float ms = timing / 1e6f;
+            tiles_per_frame = std::clamp(tiles_per_frame * std::clamp(budget_ms / ms, 0.5f, 1.25f), 1.0f, static_cast<float>(stats.tiles));
+            last_timing = timing;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[current]);
+        if (stats.perturbation) {
+            int pixel_exponent = 0;
+            float pixel_mantissa = static_cast<float>(std::frexp(getPixelSize(), &pixel_exponent));
+            perturb_shader.use();
+            perturb_shader.setInt("orbit", 1);
+            perturb_shader.setInt("orbit_length", static_cast<int>(orbit.size()));
+            perturb_shader.setInt("max_iterations", view.max_iterations);
+            perturb_shader.setFloat("half_size", 0.5f * size);
+            perturb_shader.setFloat("pixel_mantissa", pixel_mantissa);
+            perturb_shader.setInt("pixel_exponent", pixel_exponent);
+            perturb_shader.setInt("skip", static_cast<int>(stats.skipped));
+            perturb_shader.setVec2("series_a", series[0]);
+            perturb_shader.setVec2("series_b", series[1]);
+            perturb_shader.setVec2("series_c", series[2]);
+            perturb_shader.setInt("series_exponents[0]", series_exponents.x);
+            perturb_shader.setInt("series_exponents[1]", series_exponents.y);
+            perturb_shader.setInt("series_exponents[2]", series_exponents.z);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_BUFFER, orbit_texture);
+            glActiveTexture(GL_TEXTURE0);
+        }
+        else {
+            iterate_shader.use();
+            iterate_shader.setVec2("center", glm::vec2(view.center_x.toDouble(), view.center_y.toDouble()));
+            iterate_shader.setFloat("pixel_size", static_cast<float>(getPixelSize()));
+            iterate_shader.setFloat("half_size", 0.5f * size);
+            iterate_shader.setInt("max_iterations", view.max_iterations);
+        }
+
+        size_t count = std::min(queue.size(), static_cast<size_t>(tiles_per_frame));
+        tile_timer.begin();
+        for (size_t i = 0; i < count; i++) {
+            unsigned int t = queue.back();
+            queue.pop_back();
+            GLint x = (t % tiles_x) * tile_size, y = (t / tiles_x) * tile_size;
+            glViewport(x, y, std::min(tile_size, size - x), std::min(tile_size, size - y));
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            done[t] = true;
+        }
+        tile_timer.end();
+        stats.rendered += static_cast<unsigned int>(count);
+    }
+    stats.pending = static_cast<unsigned int>(queue.size());
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+    glBindVertexArray(0);
+    glEnable(GL_STENCIL_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, prev_polygon_mode[0]);
+}
+
+void MandelbrotRenderer::draw(float time) {
+    GLint prev_polygon_mode[2];
+    glGetIntegerv(GL_POLYGON_MODE, prev_polygon_mode);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(empty_vao);
+
+    colorize_shader.use();
+    colorize_shader.setInt("iterations", 0);
+    colorize_shader.setFloat("time", time);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textures[current]);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, prev_polygon_mode[0]);
+}
@@ -0,0 +1,115 @@
+#ifndef MANDELBROT_H
+#define MANDELBROT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "fixed_point.hpp"
+#include "gpu_queries.hpp"
+#include "shader.hpp"
+
+struct MandelbrotView {
+    FixedPoint center_x = FixedPoint(-0.53), center_y = FixedPoint(0.0);
+    // The view spans 2.24 / zoom vertically
+    double zoom = 1.0;
+    int max_iterations = 1000;
+
+    bool operator==(const MandelbrotView&) const = default;
+};
+
+struct MandelbrotStats {
+    unsigned int tiles = 0;
+    unsigned int pending = 0;
+    unsigned int rendered = 0;
+    unsigned int reused = 0;
+    bool perturbation = false;
+    unsigned int reference_iterations = 0;
+    unsigned int skipped = 0;
+};
+
+// Progressive Mandelbrot renderer. Continuous iteration counts are cached in an R32F texture that is computed tile
+// by tile, center first, with as many tiles per frame as fit into budget_ms of GPU time. Changing the view
+// reprojects the cache as a preview, tiles the reprojection covers exactly (panning by whole pixels) are kept and
+// only the others are recomputed. Colorizing reads the cache, so a finished image costs one fetch per pixel.
+//
+// Beyond perturbation_zoom single precision runs out, pixels then iterate their float offset from a reference
+// orbit of the view center that is computed once in fixed point on the CPU. A series approximation of that offset
+// skips the first iterations, offsets are kept as mantissa and exponent so they survive pixel sizes far below
+// float range, and pixels are rebased onto the start of the orbit whenever they get closer to zero than their
+// offset, which avoids the glitches a single reference otherwise causes.
+class MandelbrotRenderer {
+public:
+    MandelbrotView view;
+    float budget_ms = 2.0f;
+    double perturbation_zoom = 1e4;
+
+    MandelbrotRenderer(unsigned int size = 512, unsigned int tile_size = 64);
+    ~MandelbrotRenderer();
+
+    // Reallocates the cache, which is then recomputed from scratch
+    void resize(unsigned int size);
+
+    // Reprojects the cache if the view changed and renders the next tiles
+    void update();
+
+    // Colorizes the cache into the bound framebuffer
+    void draw(float time);
+
+    // Complex plane size of a pixel
+    double getPixelSize() const {
+        return 2.24 / (view.zoom * size);
+    }
+
+    GLuint getTexture() const {
+        return textures[current];
+    }
+
+    unsigned int getSize() const {
+        return size;
+    }
+
+    // GPU time of the last measured tile batch in ms
+    float getTileTime() {
+        return tile_timer.getResult() / 1e6f;
+    }
+
+    const MandelbrotStats& getStats() const {
+        return stats;
+    }
+
+private:
+    Shader iterate_shader, perturb_shader, reproject_shader, colorize_shader;
+    GLuint textures[2] = { 0, 0 }, fbos[2] = { 0, 0 };
+    GLuint empty_vao;
+    int current = 0;
+    unsigned int size, tile_size, tiles_x;
+
+    MandelbrotView cached_view;
+    bool cache_valid = false;
+    std::vector<bool> done;
+    // Tiles left to render, the next one is at the back
+    std::vector<unsigned int> queue;
+
+    // Reference orbit in double for the series, the GPU reads it as floats from a buffer texture
+    std::vector<glm::dvec2> orbit;
+    GLuint orbit_buffer, orbit_texture;
+    FixedPoint reference_x, reference_y;
+    int reference_max_iterations = -1;
+    // Series coefficients of the offset after skipped iterations as mantissas and exponents
+    glm::vec2 series[3];
+    glm::ivec3 series_exponents;
+
+    GpuCounter tile_timer;
+    GLuint64 last_timing = 0;
+    float tiles_per_frame = 4.0f;
+    MandelbrotStats stats;
+
+    void reproject();
+    void fillQueue();
+    void computeReference();
+    void computeSeries();
+};
+
+#endif // !MANDELBROT_H
@@ -0,0 +1,271 @@
+#include "mandelbrot_cpu.hpp"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+
+#include "job_system.hpp"
+
+namespace {
+    const int GROUPS = 2;
+    const int LANES = 8 * GROUPS;
+
+    struct Counters {
+        unsigned int analytic = 0;
+        unsigned int periodic = 0;
+    };
+
+    // Iterates 16 points like mandelbrot_iterate.frag, valid limits the lanes that are counted
+    void iterate(const float* cx, const float* cy, int max_iterations, float tolerance, int valid, float* result, Counters& counters) {
+        const __m256 escape = _mm256_set1_ps(16.0f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 sign = _mm256_set1_ps(-0.0f);
+
+        __m256 c_x[GROUPS], c_y[GROUPS], z_x[GROUPS], z_y[GROUPS], count[GROUPS], active[GROUPS], periodic[GROUPS], saved_x[GROUPS], saved_y[GROUPS];
+        int analytic_mask = 0;
+        for (int g = 0; g < GROUPS; g++) {
+            c_x[g] = _mm256_loadu_ps(cx + 8 * g);
+            c_y[g] = _mm256_loadu_ps(cy + 8 * g);
+
+            // The main cardioid and the period 2 bulb never escape
+            __m256 d_x = _mm256_sub_ps(c_x[g], _mm256_set1_ps(0.25f));
+            __m256 q = _mm256_fmadd_ps(d_x, d_x, _mm256_mul_ps(c_y[g], c_y[g]));
+            __m256 cardioid = _mm256_cmp_ps(_mm256_mul_ps(q, _mm256_add_ps(q, d_x)), _mm256_mul_ps(_mm256_set1_ps(0.25f), _mm256_mul_ps(c_y[g], c_y[g])), _CMP_LE_OQ);
+            __m256 b_x = _mm256_add_ps(c_x[g], one);
+            __m256 bulb = _mm256_cmp_ps(_mm256_fmadd_ps(b_x, b_x, _mm256_mul_ps(c_y[g], c_y[g])), _mm256_set1_ps(0.0625f), _CMP_LE_OQ);
+            __m256 inside = _mm256_or_ps(cardioid, bulb);
+            analytic_mask |= _mm256_movemask_ps(inside) << (8 * g);
+
+            z_x[g] = z_y[g] = saved_x[g] = saved_y[g] = _mm256_setzero_ps();
+            count[g] = _mm256_setzero_ps();
+            periodic[g] = _mm256_setzero_ps();
+            active[g] = _mm256_andnot_ps(inside, _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+        }
+
+        // Brent's cycle detection, z is saved at powers of two and compared against every iteration in between
+        int next_save = 8;
+        for (int i = 0; i < max_iterations; i++) {
+            int any = 0;
+            for (int g = 0; g < GROUPS; g++) {
+                __m256 xx = _mm256_mul_ps(z_x[g], z_x[g]);
+                __m256 yy = _mm256_mul_ps(z_y[g], z_y[g]);
+                __m256 xy = _mm256_mul_ps(z_x[g], z_y[g]);
+                __m256 new_x = _mm256_add_ps(_mm256_sub_ps(xx, yy), c_x[g]);
+                __m256 new_y = _mm256_add_ps(_mm256_add_ps(xy, xy), c_y[g]);
+                z_x[g] = _mm256_blendv_ps(z_x[g], new_x, active[g]);
+                z_y[g] = _mm256_blendv_ps(z_y[g], new_y, active[g]);
+                count[g] = _mm256_add_ps(count[g], _mm256_and_ps(active[g], one));
+
+                __m256 magnitude = _mm256_fmadd_ps(new_x, new_x, _mm256_mul_ps(new_y, new_y));
+                active[g] = _mm256_and_ps(active[g], _mm256_cmp_ps(magnitude, escape, _CMP_LE_OQ));
+
+                __m256 distance = _mm256_add_ps(
+                    _mm256_andnot_ps(sign, _mm256_sub_ps(z_x[g], saved_x[g])),
+                    _mm256_andnot_ps(sign, _mm256_sub_ps(z_y[g], saved_y[g]))
+                );
+                __m256 cycle = _mm256_and_ps(active[g], _mm256_cmp_ps(distance, _mm256_set1_ps(tolerance), _CMP_LT_OQ));
+                periodic[g] = _mm256_or_ps(periodic[g], cycle);
+                active[g] = _mm256_andnot_ps(cycle, active[g]);
+                any |= _mm256_movemask_ps(active[g]);
+            }
+            if (!any)
+                break;
+            if (i + 1 == next_save) {
+                for (int g = 0; g < GROUPS; g++) {
+                    saved_x[g] = z_x[g];
+                    saved_y[g] = z_y[g];
+                }
+                next_save *= 2;
+            }
+        }
+
+        alignas(32) float counts[LANES], xs[LANES], ys[LANES];
+        int periodic_mask = 0;
+        for (int g = 0; g < GROUPS; g++) {
+            _mm256_store_ps(counts + 8 * g, count[g]);
+            _mm256_store_ps(xs + 8 * g, z_x[g]);
+            _mm256_store_ps(ys + 8 * g, z_y[g]);
+            periodic_mask |= _mm256_movemask_ps(periodic[g]) << (8 * g);
+        }
+
+        // Continuous count for escaped points, negative inside the set
+        int valid_mask = (1 << valid) - 1;
+        counters.analytic += std::popcount(static_cast<unsigned int>(analytic_mask & valid_mask));
+        counters.periodic += std::popcount(static_cast<unsigned int>(periodic_mask & valid_mask));
+        for (int l = 0; l < valid; l++) {
+            bool inside = (analytic_mask | periodic_mask) & (1 << l);
+            int i = static_cast<int>(counts[l]);
+            result[l] = !inside && i < max_iterations ? counts[l] + 1.0f - std::log2(0.5f * std::log2(xs[l] * xs[l] + ys[l] * ys[l])) : -1.0f;
+        }
+    }
+
+    uint32_t crc32(const unsigned char* data, size_t length, uint32_t crc) {
+        static uint32_t table[256] = {};
+        if (!table[1]) {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[n] = c;
+            }
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void appendBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<unsigned char>(value >> shift));
+    }
+
+    void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+        std::vector<unsigned char> chunk;
+        appendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        appendBigEndian(chunk, crc32(chunk.data() + 4, chunk.size() - 4, 0));
+        file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+}
+
+std::vector<float> CpuMandelbrot::render(const MandelbrotView& view, unsigned int size) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Same single precision inputs as the GPU gets
+    float center_x = static_cast<float>(view.center_x.toDouble()), center_y = static_cast<float>(view.center_y.toDouble());
+    float pixel_size = static_cast<float>(2.24 / (view.zoom * size));
+    float half_size = 0.5f * size;
+    float tolerance = std::clamp(0.01f * pixel_size, 1e-7f, 1e-5f);
+
+    std::vector<float> iterations(size * size);
+    unsigned int tiles_x = (size + tile_size - 1) / tile_size;
+    unsigned int tile_count = tiles_x * tiles_x;
+
+    // One tile per job, tiles along the set cost far more than the ones outside, stealing evens that out
+    std::atomic<unsigned int> analytic = 0, periodic = 0;
+    std::atomic<uint64_t> thread_mask = 0;
+    JobSystem::get().parallelFor("Mandelbrot tile", tile_count, 1, [&](size_t first, size_t last) {
+        Counters counters;
+        alignas(32) float cx[LANES], cy[LANES], result[LANES];
+        for (size_t tile = first; tile < last; tile++) {
+            unsigned int x0 = static_cast<unsigned int>(tile % tiles_x) * tile_size, y0 = static_cast<unsigned int>(tile / tiles_x) * tile_size;
+            unsigned int x1 = std::min(x0 + tile_size, size), y1 = std::min(y0 + tile_size, size);
+            for (unsigned int y = y0; y < y1; y++) {
+                for (unsigned int x = x0; x < x1; x += LANES) {
+                    for (int l = 0; l < LANES; l++) {
+                        cx[l] = center_x + (x + l + 0.5f - half_size) * pixel_size;
+                        cy[l] = center_y + (y + 0.5f - half_size) * pixel_size;
+                    }
+                    int valid = static_cast<int>(std::min<unsigned int>(LANES, x1 - x));
+                    iterate(cx, cy, view.max_iterations, tolerance, valid, result, counters);
+                    std::copy(result, result + valid, iterations.begin() + static_cast<size_t>(y) * size + x);
+                }
+            }
+        }
+        analytic += counters.analytic;
+        periodic += counters.periodic;
+        thread_mask |= uint64_t(1) << (JobSystem::getThreadIndex() % 64);
+    });
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.ms = std::chrono::duration<float, std::milli>(end - start).count();
+    stats.mpix_per_s = static_cast<float>(size) * size / std::max(stats.ms, 1e-3f) / 1e3f;
+    stats.tiles = tile_count;
+    stats.threads = std::popcount(thread_mask.load());
+    stats.analytic = analytic;
+    stats.periodic = periodic;
+    return iterations;
+}
+
+std::vector<unsigned char> CpuMandelbrot::colorize(const std::vector<float>& iterations, unsigned int size) {
+    std::vector<unsigned char> rgb(iterations.size() * 3, 0);
+    for (unsigned int y = 0; y < size; y++) {
+        for (unsigned int x = 0; x < size; x++) {
+            float i = iterations[static_cast<size_t>(size - 1 - y) * size + x];
+            float fac = i >= 0.0f ? 1.0f - std::exp(-i) : 0.0f;
+            if (fac >= 0.1f)
+                rgb[(static_cast<size_t>(y) * size + x) * 3] = static_cast<unsigned char>(std::round(fac * 255.0f));
+        }
+    }
+    return rgb;
+}
+
+bool CpuMandelbrot::writePng(const std::string& path, const std::vector<unsigned char>& rgb, unsigned int width, unsigned int height) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cout << "ERROR::PNG:: Could not open " << path << std::endl;
+        return false;
+    }
+    const unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<unsigned char> header;
+    appendBigEndian(header, width);
+    appendBigEndian(header, height);
+    header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit RGB, no interlacing
+    writeChunk(file, "IHDR", header);
+
+    // Rows with filter type 0, wrapped in uncompressed deflate blocks
+    std::vector<unsigned char> raw;
+    raw.reserve(static_cast<size_t>(width * 3 + 1) * height);
+    for (unsigned int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb.begin() + static_cast<size_t>(y) * width * 3, rgb.begin() + static_cast<size_t>(y + 1) * width * 3);
+    }
+    std::vector<unsigned char> data = { 0x78, 0x01 };
+    for (size_t offset = 0; offset < raw.size(); offset += 65535) {
+        size_t length = std::min<size_t>(65535, raw.size() - offset);
+        data.push_back(offset + length == raw.size());
+        data.insert(data.end(), { static_cast<unsigned char>(length), static_cast<unsigned char>(length >> 8),
+            static_cast<unsigned char>(~length), static_cast<unsigned char>(~length >> 8) });
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + length);
+    }
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(data, (b << 16) | a);
+    writeChunk(file, "IDAT", data);
+    writeChunk(file, "IEND", {});
+    return static_cast<bool>(file);
+}
+
+MandelbrotDifference CpuMandelbrot::compare(const std::vector<float>& a, const std::vector<float>& b, float tolerance) {
+    MandelbrotDifference difference;
+    for (size_t i = 0; i < std::min(a.size(), b.size()); i++) {
+        bool escaped = a[i] >= 0.0f;
+        float error = escaped == (b[i] >= 0.0f) ? (escaped ? std::abs(a[i] - b[i]) : 0.0f) : INFINITY;
+        if (error > tolerance)
+            difference.mismatched++;
+        if (std::isfinite(error))
+            difference.max_error = std::max(difference.max_error, error);
+    }
+    difference.mismatched += static_cast<unsigned int>(std::max(a.size(), b.size()) - std::min(a.size(), b.size()));
+    return difference;
+}
+
+MandelbrotDifference CpuMandelbrot::compare(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int tolerance) {
+    MandelbrotDifference difference;
+    if (a.size() != b.size()) {
+        difference.mismatched = static_cast<unsigned int>(std::max(a.size(), b.size()) / 3);
+        return difference;
+    }
+    for (size_t i = 0; i + 2 < a.size(); i += 3) {
+        int error = 0;
+        for (int k = 0; k < 3; k++)
+            error = std::max(error, std::abs(a[i + k] - b[i + k]));
+        difference.mismatched += error > tolerance;
+        difference.max_error = std::max(difference.max_error, static_cast<float>(error));
+    }
+    return difference;
+}
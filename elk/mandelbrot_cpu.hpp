@@ -0,0 +1,54 @@
+#ifndef MANDELBROT_CPU_H
+#define MANDELBROT_CPU_H
+
+#include <string>
+#include <vector>
+
+#include "mandelbrot.hpp"
+
+struct CpuMandelbrotStats {
+    float ms = 0.0f;
+    float mpix_per_s = 0.0f;
+    unsigned int tiles = 0;
+    // Job system threads that rendered tiles
+    unsigned int threads = 0;
+    // Pixels finished without iterating to the limit
+    unsigned int analytic = 0;
+    unsigned int periodic = 0;
+};
+
+struct MandelbrotDifference {
+    unsigned int mismatched = 0;
+    float max_error = 0.0f;
+};
+
+// CPU version of mandelbrot_iterate.frag for headless rendering and as a reference for the GPU cache. Sixteen pixels
+// iterate together as two interleaved groups of eight AVX2 lanes, which hides the multiply latency. Points in the
+// main cardioid and the period 2 bulb are skipped, and lanes whose orbit returns to a saved point are known to be
+// periodic and stop early. Tiles are spread over the job system, whose work stealing balances the tiles along the set
+// that cost far more than the ones outside of it.
+class CpuMandelbrot {
+public:
+    unsigned int tile_size = 32;
+
+    // Continuous counts in the layout of the GPU cache, rows from the bottom and -1 inside the set
+    std::vector<float> render(const MandelbrotView& view, unsigned int size);
+
+    const CpuMandelbrotStats& getStats() const {
+        return stats;
+    }
+
+    // Colors like mandelbrot.frag without animation on black, rows from the top
+    static std::vector<unsigned char> colorize(const std::vector<float>& iterations, unsigned int size);
+    static bool writePng(const std::string& path, const std::vector<unsigned char>& rgb, unsigned int width, unsigned int height);
+
+    // Pixels that disagree on escaping or whose counts differ by more than tolerance
+    static MandelbrotDifference compare(const std::vector<float>& a, const std::vector<float>& b, float tolerance = 0.5f);
+    // Pixels with a channel that differs by more than tolerance, both images 8 bit RGB of the same size
+    static MandelbrotDifference compare(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b, int tolerance = 2);
+
+private:
+    CpuMandelbrotStats stats;
+};
+
+#endif // !MANDELBROT_CPU_H
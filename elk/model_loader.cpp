@@ -5,14 +5,60 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
+#include <map>
+#include <tuple>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-bool missing_texture_loaded = false;
-unsigned int missing_texture;
+#include "job_system.hpp"
+
+struct DecodedImage {
+    unsigned char* data = nullptr;
+    int width = 0, height = 0;
+};
+
+// Safe on any thread, stb's flip setting is per thread
+static DecodedImage decodeImage(const char* filename, bool vertical_flip, int channels) {
+    DecodedImage image;
+    int nr_channels;
+    stbi_set_flip_vertically_on_load_thread(vertical_flip);
+    image.data = stbi_load(filename, &image.width, &image.height, &nr_channels, channels);
+    if (!image.data)
+        std::cerr << "Failed to load texture " << filename << ". Reason: " << stbi_failure_reason() << std::endl;
+    return image;
+}
+
+// Takes ownership of the image data
+static GLuint uploadTexture(DecodedImage& image, bool use_alpha) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // set the texture wrapping parameters
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    // set texture filtering parameters
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (use_alpha)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.data);
+    else
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    stbi_image_free(image.data);
+    image.data = nullptr;
+    return texture;
+}
+
+// Loaded on first import so fallbacks can be resolved before any draw
+static GLuint getMissingTexture() {
+    static GLuint missing_texture = loadTexture("models/missing_texture.png");
+    return missing_texture;
+}
 
 // TODO Add mesh generation from just vertex positions, manual garbage collection required.
 Mesh::Mesh(std::vector<float> vertex_positions) :
+    material(std::vector<Texture>(), getMissingTexture()),
     vao(0),
     vbo(0),
     ebo(0)
@@ -27,68 +73,28 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std:
     this->vertices = vertices;
     this->indices = indices;
     this->textures = textures;
+    this->material = Material(textures, getMissingTexture());
 
+    computeBounds();
     setupMesh();
 }
 
-void Mesh::draw(Shader& shader) {
-    GLuint diffuse_nr = 0;
-    GLuint specular_nr = 0;
-    GLuint normal_nr = 0;
-    shader.use();
-    for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-
-        std::string name = textures[i].type;
-        if (name == "texture_diffuse") {
-            diffuse_nr += 1;
-            shader.setInt(std::format("material.texture_diffuse{}", diffuse_nr), i);
-        }
-        else if (name == "texture_specular") {
-            specular_nr += 1;
-            shader.setInt(std::format("material.texture_specular{}", specular_nr), i);
-        }
-        else if (name == "texture_normal") {
-            normal_nr += 1;
-            shader.setInt(std::format("material.texture_normal{}", normal_nr), i);
-        }
+void Mesh::computeBounds() {
+    for (const Vertex& vertex : vertices)
+        bounds.expand(vertex.pos);
 
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    sphere.center = bounds.center();
+    float radius2 = 0.0f;
+    for (const Vertex& vertex : vertices) {
+        glm::vec3 offset = vertex.pos - sphere.center;
+        radius2 = glm::max(radius2, glm::dot(offset, offset));
     }
+    sphere.radius = glm::sqrt(radius2);
+}
 
-    {
-        if (specular_nr == 0) {
-            if (!missing_texture_loaded) {
-                missing_texture = loadTexture("models/missing_texture.png");
-                missing_texture_loaded = true;
-            }
-            glActiveTexture(GL_TEXTURE10);
-            shader.setInt("material.texture_specular1", 0);
-            glBindTexture(GL_TEXTURE_2D, missing_texture);
-        }
-        if (normal_nr == 0) {
-            if (!missing_texture_loaded) {
-                missing_texture = loadTexture("models/missing_texture.png");
-                missing_texture_loaded = true;
-            }
-            glActiveTexture(GL_TEXTURE10);
-            shader.setInt("material.texture_normal1", 0);
-            glBindTexture(GL_TEXTURE_2D, missing_texture);
-        }
-        if (textures.size() == 0) {
-            if (!missing_texture_loaded) {
-                missing_texture = loadTexture("models/missing_texture.png");
-                missing_texture_loaded = true;
-            }
-            glActiveTexture(GL_TEXTURE0);
-
-            shader.setInt("material.texture_diffuse1", 0);
-            shader.setInt("material.texture_specular1", 0);
-
-            glBindTexture(GL_TEXTURE_2D, missing_texture);
-        }
-    }
-    glActiveTexture(GL_TEXTURE0);
+void Mesh::draw(Shader& shader) {
+    shader.use();
+    material.bind();
 
     glBindVertexArray(vao);
     glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
@@ -122,14 +128,81 @@ void Mesh::setupMesh() {
     glBindVertexArray(0);
 }
 
+void Mesh::setupPositionStream() {
+    if (position_vao)
+        return;
+
+    // Vertices that only differ in normal or UV collapse into one position
+    std::map<std::tuple<float, float, float>, unsigned int> unique;
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> remap(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        auto [it, inserted] = unique.try_emplace({ vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z }, static_cast<unsigned int>(positions.size()));
+        if (inserted)
+            positions.push_back(vertices[i].pos);
+        remap[i] = it->second;
+    }
+
+    std::vector<unsigned int> position_indices(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+        position_indices[i] = remap[indices[i]];
+    position_count = positions.size();
+
+    glGenVertexArrays(1, &position_vao);
+    glGenBuffers(1, &position_vbo);
+    glGenBuffers(1, &position_ebo);
+
+    glBindVertexArray(position_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, position_vbo);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, position_ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, position_indices.size() * sizeof(unsigned int), position_indices.data(), GL_STATIC_DRAW);
+
+    // vertex positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+    glBindVertexArray(0);
+}
+
+void Mesh::drawPositions(Shader& shader) {
+    shader.use();
+    // Position is attribute 0 in both streams
+    glBindVertexArray(position_vao ? position_vao : vao);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
+
 class modelImpl {
 private:
     std::vector<Texture> textures_loaded;
     std::string directory;
+    // Texture files decoded before the meshes are processed, 0 if the file failed to load
+    std::map<std::string, GLuint> preloaded;
 public:
     std::vector<Mesh> meshes;
     bool vertical_flip, use_alpha, use_normal_maps;
 
+    AABB bounds;
+    // Scratch space for culling, reused between draws
+    std::vector<AABB> world_bounds;
+    std::vector<unsigned char> visible;
+
+    // Fills visible for every mesh, only mesh_nr can pass if it names a mesh. Returns false if nothing is visible.
+    bool cullMeshes(const glm::mat4& model, FrustumCuller& culler, int mesh_nr) {
+        size_t single = mesh_nr > -1 ? static_cast<size_t>(mesh_nr) : meshes.size();
+        if (single < meshes.size()) {
+            visible.assign(meshes.size(), 0);
+            visible[single] = culler.test(meshes[single].bounds.transform(model));
+            return visible[single];
+        }
+
+        world_bounds.resize(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+            world_bounds[i] = meshes[i].bounds.transform(model);
+        return culler.test(world_bounds, visible) != 0;
+    }
+
     modelImpl(const char* path, bool vertically_flip_textures, bool use_alpha, bool use_normal_maps) :
         vertical_flip(vertically_flip_textures),
         use_alpha(use_alpha),
@@ -154,7 +227,43 @@ public:
         }
         directory = path.substr(0, path.find_last_of('/'));
 
+        preloadTextures(scene);
         processNode(scene->mRootNode, scene);
+
+        for (const Mesh& mesh : meshes)
+            bounds.expand(mesh.bounds);
+    }
+
+    // Decodes the textures of all meshes as jobs, each queues its upload on the main thread lane, which runs while
+    // this thread waits
+    void preloadTextures(const aiScene* scene) {
+        std::vector<aiTextureType> types = { aiTextureType_DIFFUSE, aiTextureType_SPECULAR };
+        if (use_normal_maps)
+            types.push_back(aiTextureType_HEIGHT);
+
+        std::vector<std::string> paths;
+        for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+            aiMaterial* material = scene->mMaterials[scene->mMeshes[m]->mMaterialIndex];
+            for (aiTextureType type : types) {
+                for (unsigned int i = 0; i < material->GetTextureCount(type); i++) {
+                    aiString str;
+                    material->GetTexture(type, i, &str);
+                    if (preloaded.try_emplace(str.C_Str(), 0).second)
+                        paths.push_back(str.C_Str());
+                }
+            }
+        }
+
+        JobSystem& jobs = JobSystem::get();
+        JobCounter counter;
+        for (const std::string& path : paths) {
+            jobs.run("Texture decode", [this, &jobs, &counter, &path]() {
+                DecodedImage image = decodeImage(std::format("{}/{}", directory, path).c_str(), vertical_flip, 4);
+                if (image.data)
+                    jobs.runOnMain("Texture upload", [this, &path, image]() mutable { preloaded[path] = uploadTexture(image, true); }, &counter);
+            }, &counter);
+        }
+        jobs.wait(counter);
     }
 
     void processNode(aiNode* node, const aiScene* scene) {
@@ -204,19 +313,19 @@ public:
 
         if (mesh->mMaterialIndex >= 0) {
             aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-            std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+            std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, TextureSlot::DIFFUSE);
             textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
-            std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+            std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, TextureSlot::SPECULAR);
             textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
             if (use_normal_maps) {
-                std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+                std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, TextureSlot::NORMAL);
                 textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
             }
         }
         return Mesh(vertices, indices, textures);
     }
 
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string type_name) {
+    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, TextureSlot slot) {
         std::vector<Texture> textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
             aiString str;
@@ -231,8 +340,9 @@ public:
             }
             if (!skip) {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = loadTexture(std::format("{}/{}", directory, str.C_Str()).c_str(), this->vertical_flip, true);
-                texture.type = type_name;
+                auto it = preloaded.find(str.C_Str());
+                texture.id = it != preloaded.end() ? it->second : loadTexture(std::format("{}/{}", directory, str.C_Str()).c_str(), this->vertical_flip, true);
+                texture.type = slot;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);
@@ -258,8 +368,14 @@ std::vector<Mesh>& Model::getMeshes() {
     return pimpl->meshes;
 }
 
+const AABB& Model::getBounds() const {
+    return pimpl->bounds;
+}
+
 void Model::draw(Shader& shader, int mesh_nr) {
     // TODO Add transforms to each mesh, as they currently all render at origin
+    shader.use();
+    Material::bindSamplers(shader);
     if (mesh_nr > -1 && mesh_nr < pimpl->meshes.size()) {
         pimpl->meshes[mesh_nr].draw(shader);
         return;
@@ -269,6 +385,53 @@ void Model::draw(Shader& shader, int mesh_nr) {
     }
 }
 
+void Model::draw(Shader& shader, const glm::mat4& model, FrustumCuller& culler, int mesh_nr) {
+    if (!pimpl->cullMeshes(model, culler, mesh_nr))
+        return;
+
+    shader.use();
+    shader.setMat4("model", model);
+    Material::bindSamplers(shader);
+    for (size_t i = 0; i < pimpl->meshes.size(); i++) {
+        if (pimpl->visible[i])
+            pimpl->meshes[i].draw(shader);
+    }
+}
+
+void Model::setupPositionStreams() {
+    for (Mesh& mesh : pimpl->meshes)
+        mesh.setupPositionStream();
+}
+
+void Model::drawPositions(Shader& shader, const glm::mat4& model, FrustumCuller& culler, int mesh_nr) {
+    if (!pimpl->cullMeshes(model, culler, mesh_nr))
+        return;
+
+    shader.use();
+    shader.setMat4("model", model);
+    for (size_t i = 0; i < pimpl->meshes.size(); i++) {
+        if (pimpl->visible[i])
+            pimpl->meshes[i].drawPositions(shader);
+    }
+}
+
+void Model::record(DrawRecorder& recorder, Shader& shader, const glm::mat4& model, const Frustum* frustum, bool positions, int mesh_nr) const {
+    // Out of range when every mesh is recorded
+    size_t single = mesh_nr > -1 ? static_cast<size_t>(mesh_nr) : pimpl->meshes.size();
+    for (size_t i = 0; i < pimpl->meshes.size(); i++) {
+        if (single < pimpl->meshes.size() && i != single)
+            continue;
+        const Mesh& mesh = pimpl->meshes[i];
+        if (frustum) {
+            bool visible = frustum->intersects(mesh.bounds.transform(model));
+            recorder.countCulled(visible);
+            if (!visible)
+                continue;
+        }
+        recorder.draw(shader, mesh.getVao(positions), static_cast<GLsizei>(mesh.indices.size()), positions ? nullptr : &mesh.material, model);
+    }
+}
+
 Skybox::Skybox(const char* vert_path, const char* frag_path, std::vector<std::string>& face_paths) : skybox_shader(vert_path, frag_path) {
     cubemap_texture = loadCubemap(face_paths);
     float skybox_vertices[] = {
@@ -343,57 +506,29 @@ void Skybox::draw(glm::mat4& proj, glm::mat4& view) {
 }
 
 GLuint loadTexture(const char* filename, bool vertical_flip, bool use_alpha) {
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    // set the texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image, create texture and generate mipmaps
-    int width, height, nrChannels;
-    if (vertical_flip)
-        stbi_set_flip_vertically_on_load(true);
-    else
-        stbi_set_flip_vertically_on_load(false);
-
-    unsigned char* data = stbi_load(filename, &width, &height, &nrChannels, 3 + use_alpha);
-    if (data) {
-        if (use_alpha)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        else
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
-        std::cerr << "Failed to load texture " << filename << ". Reason: " << stbi_failure_reason() << std::endl;
-        return 0;
-    }
-    stbi_image_free(data);
-    return texture;
+    DecodedImage image = decodeImage(filename, vertical_flip, 3 + use_alpha);
+    return image.data ? uploadTexture(image, use_alpha) : 0;
 }
 GLuint loadCubemap(std::vector<std::string>& faces) {
     GLuint texture;
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
 
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(false);
+    // Faces are decoded as jobs, the uploads stay on this thread
+    std::vector<DecodedImage> images(faces.size());
+    JobSystem::get().parallelFor("Cubemap decode", faces.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            images[i] = decodeImage(faces[i].c_str(), false, 3);
+    });
     for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 3);
-        if (data) {
+        if (images[i].data) {
             glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
+                0, GL_RGB, images[i].width, images[i].height, 0, GL_RGB, GL_UNSIGNED_BYTE, images[i].data
             );
-            stbi_image_free(data);
+            stbi_image_free(images[i].data);
         }
         else
-        {
             std::cerr << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
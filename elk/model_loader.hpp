@@ -13,6 +13,8 @@
 
 #include "shader.hpp"
 #include "common.hpp"
+#include "culling.hpp"
+#include "draw_list.hpp"
 
 GLuint loadTexture(const char*, bool = true, bool = false);
 GLuint loadCubemap(std::vector<std::string>& faces);
@@ -22,17 +24,40 @@ public:
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
     std::vector<Texture> textures;
+    Material material;
+
+    // Object space bounds computed at import
+    AABB bounds;
+    BoundingSphere sphere;
 
     Mesh(std::vector<float> vertex_positions);
     
     Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
 
+    // Expects the program's samplers to be set with Material::bindSamplers
     void draw(Shader& shader);
 
+    // Separate tightly packed position stream for depth-only passes, vertices are de-duplicated by position alone
+    void setupPositionStream();
+
+    // Draws the position stream, or the full vertex stream if there is none
+    void drawPositions(Shader& shader);
+
+    GLuint getVao(bool positions) const {
+        return positions && position_vao ? position_vao : vao;
+    }
+
+    size_t getPositionCount() const {
+        return position_vao ? position_count : vertices.size();
+    }
+
 private:
     unsigned int vao, vbo, ebo;
+    unsigned int position_vao = 0, position_vbo = 0, position_ebo = 0;
+    size_t position_count = 0;
 
     void setupMesh();
+    void computeBounds();
 };
 
 class modelImpl;
@@ -45,8 +70,23 @@ public:
 
     void draw(Shader& shader, int mesh_nr = -1);
 
+    // Sets the model matrix and draws only the meshes whose world space bounds pass the culler
+    void draw(Shader& shader, const glm::mat4& model, FrustumCuller& culler, int mesh_nr = -1);
+
+    // Gives every mesh a position only stream, drawPositions falls back to the full stream without it
+    void setupPositionStreams();
+
+    // Depth-only variant of draw, no material is bound
+    void drawPositions(Shader& shader, const glm::mat4& model, FrustumCuller& culler, int mesh_nr = -1);
+
+    // Records the meshes passing the frustum into a draw list, every mesh without one. Only reads the model, so
+    // worker threads can record it concurrently. Positions records the depth-only stream without materials.
+    void record(DrawRecorder& recorder, Shader& shader, const glm::mat4& model, const Frustum* frustum, bool positions, int mesh_nr = -1) const;
+
     std::vector<Mesh>& getMeshes();
 
+    const AABB& getBounds() const;
+
 private:
     std::unique_ptr<modelImpl> pimpl;
 };
@@ -0,0 +1,263 @@
+#include "occlusion.hpp"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#include "model_loader.hpp"
+
+const int TILE_SIZE = 8;
+
+Occluder makeOccluder(Model& model, float cell_size) {
+    Occluder occluder;
+    std::map<std::tuple<int, int, int>, unsigned int> clusters;
+
+    for (const Mesh& mesh : model.getMeshes()) {
+        std::vector<unsigned int> remap(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            const glm::vec3& pos = mesh.vertices[i].pos;
+            if (cell_size <= 0.0f) {
+                remap[i] = static_cast<unsigned int>(occluder.positions.size());
+                occluder.positions.push_back(pos);
+                continue;
+            }
+
+            glm::ivec3 cell = glm::ivec3(glm::floor(pos / cell_size));
+            auto [cluster, inserted] = clusters.try_emplace({ cell.x, cell.y, cell.z }, static_cast<unsigned int>(occluder.positions.size()));
+            if (inserted)
+                occluder.positions.push_back(pos);
+            remap[i] = cluster->second;
+        }
+
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            unsigned int a = remap[mesh.indices[i]], b = remap[mesh.indices[i + 1]], c = remap[mesh.indices[i + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            occluder.indices.insert(occluder.indices.end(), { a, b, c });
+        }
+    }
+    return occluder;
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height, int nr_bands) :
+    width((width + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE),
+    height((height + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE),
+    nr_bands(std::max(1, nr_bands)),
+    proj_view(1.0f)
+{
+    tiles_x = this->width / TILE_SIZE;
+    tiles_y = this->height / TILE_SIZE;
+    depth.assign(this->width * this->height, 1.0f);
+    tile_max.assign(tiles_x * tiles_y, 1.0f);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+    wait();
+    if (debug_texture)
+        glDeleteTextures(1, &debug_texture);
+}
+
+void OcclusionCuller::begin(const glm::mat4& proj_view, const std::vector<Occluder*>& occluders) {
+    wait();
+    this->proj_view = proj_view;
+    stats = CullStats();
+
+    clip_positions.clear();
+    clip_indices.clear();
+    for (const Occluder* occluder : occluders) {
+        unsigned int base = static_cast<unsigned int>(clip_positions.size());
+        glm::mat4 mvp = proj_view * occluder->model;
+        for (const glm::vec3& pos : occluder->positions)
+            clip_positions.push_back(mvp * glm::vec4(pos, 1.0f));
+        for (unsigned int index : occluder->indices)
+            clip_indices.push_back(base + index);
+    }
+
+    JobSystem::get().run("Occlusion rasterization", [this]() { rasterize(); }, &pending);
+}
+
+void OcclusionCuller::wait() {
+    JobSystem::get().wait(pending);
+}
+
+void OcclusionCuller::rasterize() {
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    // Bands are tile aligned so each job owns its rows of the depth buffer and tile level
+    int band_tiles = (tiles_y + nr_bands - 1) / nr_bands;
+    JobSystem::get().parallelFor("Occlusion band", nr_bands, 1, [this, band_tiles](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; band++) {
+            int y_begin = static_cast<int>(band) * band_tiles * TILE_SIZE;
+            int y_end = std::min(height, (static_cast<int>(band) + 1) * band_tiles * TILE_SIZE);
+            if (y_begin < y_end)
+                rasterizeBand(y_begin, y_end);
+        }
+    });
+}
+
+void OcclusionCuller::rasterizeBand(int y_begin, int y_end) {
+    for (size_t i = 0; i + 2 < clip_indices.size(); i += 3) {
+        glm::vec4 clip[3] = { clip_positions[clip_indices[i]], clip_positions[clip_indices[i + 1]], clip_positions[clip_indices[i + 2]] };
+        // Triangles crossing the near plane are skipped, dropping an occluder is always conservative. Also covers
+        // vertices behind the eye, whose z is below -w too.
+        if (clip[0].z < -clip[0].w || clip[1].z < -clip[1].w || clip[2].z < -clip[2].w)
+            continue;
+
+        glm::vec3 v[3];
+        for (int k = 0; k < 3; k++) {
+            glm::vec3 ndc = glm::vec3(clip[k]) / clip[k].w;
+            v[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+        }
+
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+        if (area == 0.0f)
+            continue;
+        if (area < 0.0f) {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        int min_x = std::max(0, static_cast<int>(glm::floor(glm::min(v[0].x, glm::min(v[1].x, v[2].x)))));
+        int max_x = std::min(width - 1, static_cast<int>(glm::ceil(glm::max(v[0].x, glm::max(v[1].x, v[2].x)))));
+        int min_y = std::max(y_begin, static_cast<int>(glm::floor(glm::min(v[0].y, glm::min(v[1].y, v[2].y)))));
+        int max_y = std::min(y_end - 1, static_cast<int>(glm::ceil(glm::max(v[0].y, glm::max(v[1].y, v[2].y)))));
+        if (min_x > max_x || min_y > max_y)
+            continue;
+        if (glm::min(v[0].z, glm::min(v[1].z, v[2].z)) > 1.0f)
+            continue;
+
+        // Edge function e_k(x, y) = a_k * x + b_k * y + c_k is positive inside for the edge opposite vertex k
+        float a[3], b[3], c[3];
+        for (int k = 0; k < 3; k++) {
+            const glm::vec3& p = v[(k + 1) % 3];
+            const glm::vec3& q = v[(k + 2) % 3];
+            a[k] = p.y - q.y;
+            b[k] = q.x - p.x;
+            c[k] = p.x * q.y - p.y * q.x;
+        }
+        float inv_area = 1.0f / area;
+        // Depth is affine in screen space: z = dz_dx * x + dz_dy * y + z_c
+        float dz_dx = (a[0] * v[0].z + a[1] * v[1].z + a[2] * v[2].z) * inv_area;
+        float dz_dy = (b[0] * v[0].z + b[1] * v[1].z + b[2] * v[2].z) * inv_area;
+        float z_c = (c[0] * v[0].z + c[1] * v[1].z + c[2] * v[2].z) * inv_area;
+
+        int start_x = min_x & ~7;
+        for (int y = min_y; y <= max_y; y++) {
+            float py = y + 0.5f;
+            float* row = depth.data() + y * width;
+#if defined(__AVX2__)
+            const __m256 lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+            __m256 e_row[3];
+            for (int k = 0; k < 3; k++)
+                e_row[k] = _mm256_set1_ps(b[k] * py + c[k]);
+            __m256 z_row = _mm256_set1_ps(dz_dy * py + z_c);
+            for (int x = start_x; x <= max_x; x += 8) {
+                __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lane);
+                __m256 e0 = _mm256_fmadd_ps(_mm256_set1_ps(a[0]), px, e_row[0]);
+                __m256 e1 = _mm256_fmadd_ps(_mm256_set1_ps(a[1]), px, e_row[1]);
+                __m256 e2 = _mm256_fmadd_ps(_mm256_set1_ps(a[2]), px, e_row[2]);
+                __m256 inside = _mm256_and_ps(
+                    _mm256_cmp_ps(_mm256_min_ps(e0, _mm256_min_ps(e1, e2)), _mm256_setzero_ps(), _CMP_GE_OQ),
+                    _mm256_cmp_ps(px, _mm256_set1_ps(static_cast<float>(width)), _CMP_LT_OQ)
+                );
+                if (_mm256_movemask_ps(inside) == 0)
+                    continue;
+                __m256 z = _mm256_fmadd_ps(_mm256_set1_ps(dz_dx), px, z_row);
+                __m256 current = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, _mm256_min_ps(current, z), inside));
+            }
+#else
+            for (int x = min_x; x <= max_x; x++) {
+                float px = x + 0.5f;
+                if (a[0] * px + b[0] * py + c[0] < 0.0f || a[1] * px + b[1] * py + c[1] < 0.0f || a[2] * px + b[2] * py + c[2] < 0.0f)
+                    continue;
+                row[x] = std::min(row[x], dz_dx * px + dz_dy * py + z_c);
+            }
+#endif
+        }
+    }
+
+    for (int ty = y_begin / TILE_SIZE; ty < y_end / TILE_SIZE; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            float max_depth = 0.0f;
+            for (int y = ty * TILE_SIZE; y < (ty + 1) * TILE_SIZE; y++) {
+                const float* row = depth.data() + y * width + tx * TILE_SIZE;
+                for (int x = 0; x < TILE_SIZE; x++)
+                    max_depth = std::max(max_depth, row[x]);
+            }
+            tile_max[ty * tiles_x + tx] = max_depth;
+        }
+    }
+}
+
+bool OcclusionCuller::test(const AABB& box) {
+    glm::vec2 rect_min(std::numeric_limits<float>::max()), rect_max(std::numeric_limits<float>::lowest());
+    float min_z = 1.0f;
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? box.max.x : box.min.x, (i & 2) ? box.max.y : box.min.y, (i & 4) ? box.max.z : box.min.z);
+        glm::vec4 clip = proj_view * glm::vec4(corner, 1.0f);
+        if (clip.z < -clip.w) {
+            stats.visible++;
+            return true;
+        }
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        glm::vec2 screen((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height);
+        rect_min = glm::min(rect_min, screen);
+        rect_max = glm::max(rect_max, screen);
+        min_z = std::min(min_z, ndc.z * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, static_cast<int>(glm::floor(rect_min.x)));
+    int x1 = std::min(width - 1, static_cast<int>(glm::ceil(rect_max.x)));
+    int y0 = std::max(0, static_cast<int>(glm::floor(rect_min.y)));
+    int y1 = std::min(height - 1, static_cast<int>(glm::ceil(rect_max.y)));
+    if (x0 > x1 || y0 > y1) {
+        stats.visible++;
+        return true;
+    }
+
+    for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ty++) {
+        for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; tx++) {
+            if (min_z > tile_max[ty * tiles_x + tx])
+                continue;
+
+            // The tile has farther depths than the box, check the covered pixels
+            for (int y = std::max(y0, ty * TILE_SIZE); y <= std::min(y1, (ty + 1) * TILE_SIZE - 1); y++) {
+                for (int x = std::max(x0, tx * TILE_SIZE); x <= std::min(x1, (tx + 1) * TILE_SIZE - 1); x++) {
+                    if (min_z <= depth[y * width + x]) {
+                        stats.visible++;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    stats.culled++;
+    return false;
+}
+
+GLuint OcclusionCuller::updateDebugTexture() {
+    if (!debug_texture) {
+        glGenTextures(1, &debug_texture);
+        glBindTexture(GL_TEXTURE_2D, debug_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // Depth is non-linear, a power curve keeps near and far occluders distinguishable
+    debug_pixels.resize(width * height * 4);
+    for (int i = 0; i < width * height; i++) {
+        unsigned char value = static_cast<unsigned char>(255.0f * (1.0f - glm::pow(depth[i], 32.0f)));
+        debug_pixels[4 * i + 0] = value;
+        debug_pixels[4 * i + 1] = value;
+        debug_pixels[4 * i + 2] = value;
+        debug_pixels[4 * i + 3] = 255;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, debug_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, debug_pixels.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return debug_texture;
+}
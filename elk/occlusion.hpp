@@ -0,0 +1,68 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "culling.hpp"
+#include "job_system.hpp"
+
+class Model;
+
+// Simplified occluder geometry in object space
+struct Occluder {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    glm::mat4 model = glm::mat4(1.0f);
+};
+
+// Builds an occluder from all meshes of a model, merging vertices on a grid of cell_size (0 keeps every triangle).
+// Each cell keeps the first original vertex that falls into it, an average could leave the surface where the mesh
+// is concave and let the occluder cover more than the model does.
+Occluder makeOccluder(Model& model, float cell_size = 0.0f);
+
+// Low resolution software depth buffer with an 8x8 tile max-depth level. Occluders are rasterized as jobs in
+// nr_bands horizontal bands while the GL thread keeps going, boxes are tested once the frame's buffer is ready.
+class OcclusionCuller {
+public:
+    const int width, height;
+    const int nr_bands;
+
+    OcclusionCuller(int width = 320, int height = 192, int nr_bands = 8);
+    ~OcclusionCuller();
+
+    // Starts rasterizing the occluders for this frame, occluders must stay alive and unchanged until wait()
+    void begin(const glm::mat4& proj_view, const std::vector<Occluder*>& occluders);
+    void wait();
+
+    // Returns false if the world space box is fully behind the rasterized occluders
+    bool test(const AABB& box);
+
+    // Uploads the depth buffer as a grayscale texture for the dashboard
+    GLuint updateDebugTexture();
+
+    const CullStats& getStats() const {
+        return stats;
+    }
+
+private:
+    std::vector<float> depth;
+    std::vector<float> tile_max;
+    int tiles_x, tiles_y;
+
+    glm::mat4 proj_view;
+    std::vector<glm::vec4> clip_positions;
+    std::vector<unsigned int> clip_indices;
+    JobCounter pending;
+
+    CullStats stats;
+    GLuint debug_texture = 0;
+    std::vector<unsigned char> debug_pixels;
+
+    void rasterize();
+    void rasterizeBand(int y_begin, int y_end);
+};
+
+#endif // !OCCLUSION_H
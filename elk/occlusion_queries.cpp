@@ -0,0 +1,133 @@
+#include "occlusion_queries.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+OcclusionQueries::OcclusionQueries(int retest_interval, bool conditional_render) :
+    retest_interval(retest_interval),
+    conditional_render(conditional_render),
+    // Only depth testing matters, the solid color program is reused with color writes masked
+    box_shader("shaders/light.vert", "shaders/light.frag"),
+    camera_pos(0.0f)
+{
+    // Unit cube from (0, 0, 0) to (1, 1, 1), scaled to the tested bounds
+    float vertices[] = {
+        0, 0, 0,  1, 1, 0,  1, 0, 0,   0, 0, 0,  0, 1, 0,  1, 1, 0,
+        0, 0, 1,  1, 0, 1,  1, 1, 1,   0, 0, 1,  1, 1, 1,  0, 1, 1,
+        0, 0, 0,  0, 0, 1,  0, 1, 1,   0, 0, 0,  0, 1, 1,  0, 1, 0,
+        1, 0, 0,  1, 1, 1,  1, 0, 1,   1, 0, 0,  1, 1, 0,  1, 1, 1,
+        0, 0, 0,  1, 0, 0,  1, 0, 1,   0, 0, 0,  1, 0, 1,  0, 0, 1,
+        0, 1, 0,  1, 1, 1,  1, 1, 0,   0, 1, 0,  0, 1, 1,  1, 1, 1,
+    };
+    glGenVertexArrays(1, &box_vao);
+    glGenBuffers(1, &box_vbo);
+    glBindVertexArray(box_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, box_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+}
+
+OcclusionQueries::~OcclusionQueries() {
+    for (auto& [id, entry] : entries)
+        glDeleteQueries(1, &entry.query);
+    glDeleteVertexArrays(1, &box_vao);
+    glDeleteBuffers(1, &box_vbo);
+}
+
+void OcclusionQueries::begin(const glm::mat4& proj, const glm::mat4& view, const glm::vec3& camera_pos) {
+    frame++;
+    stats = OcclusionQueryStats();
+    this->camera_pos = camera_pos;
+
+    box_shader.use();
+    box_shader.setMat4("proj", proj);
+    box_shader.setMat4("view", view);
+}
+
+void OcclusionQueries::issueQuery(Entry& entry, const AABB& bounds) {
+    GLint stencil_mask, depth_func;
+    GLboolean cull_face = glIsEnabled(GL_CULL_FACE), depth_mask;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+    glGetIntegerv(GL_STENCIL_WRITEMASK, &stencil_mask);
+    glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glStencilMask(0x00);
+    glDisable(GL_CULL_FACE);
+    // The main pass may be running with GL_EQUAL after a depth pre-pass
+    glDepthFunc(GL_LEQUAL);
+
+    glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), bounds.min), bounds.max - bounds.min);
+    box_shader.use();
+    box_shader.setMat4("model", model);
+
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, entry.query);
+    glBindVertexArray(box_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(depth_mask);
+    glStencilMask(stencil_mask);
+    glDepthFunc(depth_func);
+    if (cull_face)
+        glEnable(GL_CULL_FACE);
+
+    entry.pending = true;
+    entry.last_test = frame;
+    stats.queries++;
+}
+
+bool OcclusionQueries::beginDraw(unsigned int id, const AABB& bounds) {
+    Entry& entry = entries[id];
+    if (!entry.query)
+        glGenQueries(1, &entry.query);
+
+    // Collect the previous result without stalling
+    if (entry.pending) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint any_samples = 0;
+            glGetQueryObjectuiv(entry.query, GL_QUERY_RESULT, &any_samples);
+            entry.visible = any_samples != 0;
+            entry.pending = false;
+        }
+    }
+
+    // The box would be clipped by the near plane with the camera inside it
+    glm::vec3 margin(0.1f);
+    if (glm::all(glm::greaterThan(camera_pos, bounds.min - margin)) && glm::all(glm::lessThan(camera_pos, bounds.max + margin))) {
+        entry.visible = true;
+        in_conditional = false;
+        return true;
+    }
+
+    // Hidden objects are tested every frame, visible ones staggered every retest_interval frames
+    bool due = !entry.visible || (frame + id) % retest_interval == 0 || frame - entry.last_test >= static_cast<unsigned int>(retest_interval);
+    if (due && !entry.pending) {
+        issueQuery(entry, bounds);
+        if (conditional_render) {
+            glBeginConditionalRender(entry.query, GL_QUERY_NO_WAIT);
+            in_conditional = true;
+            stats.conditional++;
+            return true;
+        }
+    }
+
+    in_conditional = false;
+    if (!entry.visible) {
+        stats.skipped++;
+        return false;
+    }
+    return true;
+}
+
+void OcclusionQueries::endDraw() {
+    if (in_conditional)
+        glEndConditionalRender();
+    in_conditional = false;
+}
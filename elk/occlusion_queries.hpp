@@ -0,0 +1,59 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <map>
+
+#include "culling.hpp"
+#include "shader.hpp"
+
+struct OcclusionQueryStats {
+    unsigned int queries = 0;
+    unsigned int skipped = 0;
+    unsigned int conditional = 0;
+};
+
+// Hardware occlusion queries for heavy objects. A query draws the object's bounding box with color and depth
+// writes off, the real draw is then either predicated on it with conditional rendering or decided from the last
+// available result so the CPU never waits on the GPU. Visible objects are only re-tested every retest_interval frames.
+class OcclusionQueries {
+public:
+    int retest_interval;
+    bool conditional_render;
+
+    OcclusionQueries(int retest_interval = 8, bool conditional_render = true);
+    ~OcclusionQueries();
+
+    void begin(const glm::mat4& proj, const glm::mat4& view, const glm::vec3& camera_pos);
+
+    // Returns false if the draw can be skipped, otherwise the draw must be followed by endDraw
+    bool beginDraw(unsigned int id, const AABB& bounds);
+    void endDraw();
+
+    const OcclusionQueryStats& getStats() const {
+        return stats;
+    }
+
+private:
+    struct Entry {
+        GLuint query = 0;
+        bool visible = true;
+        bool pending = false;
+        unsigned int last_test = 0;
+    };
+
+    std::map<unsigned int, Entry> entries;
+    Shader box_shader;
+    GLuint box_vao, box_vbo;
+
+    glm::vec3 camera_pos;
+    unsigned int frame = 0;
+    bool in_conditional = false;
+    OcclusionQueryStats stats;
+
+    void issueQuery(Entry& entry, const AABB& bounds);
+};
+
+#endif // !OCCLUSION_QUERIES_H
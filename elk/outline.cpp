@@ -0,0 +1,92 @@
+#include "outline.hpp"
+
+OutlinePass::OutlinePass() :
+    seed_shader("shaders/deferred.vert", "shaders/outline_seed.frag"),
+    flood_shader("shaders/deferred.vert", "shaders/outline_flood.frag"),
+    composite_shader("shaders/deferred.vert", "shaders/outline_composite.frag")
+{
+    glGenVertexArrays(1, &empty_vao);
+}
+
+OutlinePass::~OutlinePass() {
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+void OutlinePass::beginFullscreen(bool stencil) {
+    glGetIntegerv(GL_POLYGON_MODE, prev_polygon_mode);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_DEPTH_TEST);
+    glStencilMask(0x00);
+    if (!stencil)
+        glDisable(GL_STENCIL_TEST);
+    glBindVertexArray(empty_vao);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void OutlinePass::endFullscreen() {
+    glPolygonMode(GL_FRONT_AND_BACK, prev_polygon_mode[0]);
+    glBindVertexArray(0);
+    glStencilFunc(GL_ALWAYS, 1, 0xFF);
+    glStencilMask(0xFF);
+    glEnable(GL_STENCIL_TEST);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void OutlinePass::addPasses(FrameGraph& graph, FrameResource color, FrameResource depth_stencil, float outline_width, const glm::vec4& outline_color) {
+    // Integer pixel coordinates of the nearest seed, (-1, -1) if none was found yet
+    const TextureDesc& color_desc = graph.getDesc(color);
+    TextureDesc seeds_desc = { color_desc.width, color_desc.height, GL_RG16I };
+
+    FrameResource seeds = graph.create("Outline seeds", seeds_desc);
+    graph.addPass("Outline seed", [this](FrameGraph&) {
+        beginFullscreen(true);
+
+        GLint no_seed[] = { -1, -1, 0, 0 };
+        glClearBufferiv(GL_COLOR, 0, no_seed);
+        glStencilFunc(GL_EQUAL, 1, 0xFF);
+        seed_shader.use();
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        endFullscreen();
+    }).write(seeds).depthStencil(depth_stencil, false);
+
+    // Distances beyond the outline width are never needed, so the flood starts at the next power of two. Every
+    // step writes a new texture, the graph folds them onto two alternating allocations.
+    int step = 1;
+    while (step < outline_width)
+        step *= 2;
+
+    for (; step >= 1; step /= 2) {
+        FrameResource flooded = graph.create("Outline flood", seeds_desc);
+        graph.addPass("Outline flood", [this, seeds, step](FrameGraph& graph) {
+            beginFullscreen(false);
+
+            flood_shader.use();
+            flood_shader.setInt("seeds", 0);
+            flood_shader.setInt("jump", step);
+            glBindTexture(GL_TEXTURE_2D, graph.getTexture(seeds));
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+            endFullscreen();
+            }).read(seeds).write(flooded);
+        seeds = flooded;
+    }
+
+    // Blend the outline outside of the mask
+    graph.addPass("Outline composite", [this, seeds, outline_width, outline_color](FrameGraph& graph) {
+        beginFullscreen(true);
+        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        composite_shader.use();
+        composite_shader.setInt("seeds", 0);
+        composite_shader.setFloat("outline_width", outline_width);
+        composite_shader.setVec4("outline_color", outline_color);
+        glBindTexture(GL_TEXTURE_2D, graph.getTexture(seeds));
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        glDisable(GL_BLEND);
+        endFullscreen();
+    }).read(seeds).write(color).depthStencil(depth_stencil, false);
+}
@@ -0,0 +1,30 @@
+#ifndef OUTLINE_H
+#define OUTLINE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "frame_graph.hpp"
+#include "shader.hpp"
+
+// Screen-space outline around everything drawn with stencil value 1. The stencil mask seeds a jump flood that
+// finds each pixel's nearest masked pixel in log2(width) fullscreen passes, the composite then draws a constant
+// width outline at a cost independent of the outlined geometry.
+class OutlinePass {
+public:
+    OutlinePass();
+    ~OutlinePass();
+
+    // Adds the seed, flood and composite passes outlining the stencil mask of depth_stencil into color
+    void addPasses(FrameGraph& graph, FrameResource color, FrameResource depth_stencil, float outline_width, const glm::vec4& outline_color);
+
+private:
+    Shader seed_shader, flood_shader, composite_shader;
+    GLuint empty_vao;
+    GLint prev_polygon_mode[2];
+
+    void beginFullscreen(bool stencil);
+    void endFullscreen();
+};
+
+#endif // !OUTLINE_H
@@ -0,0 +1,242 @@
+#include "post_processing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+
+const char* const FULLSCREEN_VERT = R"(#version 330 core
+const vec2 quad_vertices[4] = vec2[4]( vec2( -1.0, -1.0), vec2( 1.0, -1.0), vec2( -1.0, 1.0), vec2( 1.0, 1.0));
+
+out vec2 tex_coord;
+
+void main() {
+    gl_Position = vec4(quad_vertices[gl_VertexID], 0.0, 1.0);
+    tex_coord = quad_vertices[gl_VertexID] * 0.5 + 0.5;
+}
+)";
+
+std::vector<float> getSharpenKernel(float strength, bool detect_edges) {
+    std::vector<float> kernel(9, -strength);
+    kernel[4] = (detect_edges ? 0.0f : 1.0f) + 8.0f * strength;
+    return kernel;
+}
+
+std::vector<float> getBinomialKernel(int size) {
+    std::vector<float> row(1, 1.0f);
+    for (int i = 1; i < size; i++) {
+        row.push_back(0.0f);
+        for (int j = i; j > 0; j--)
+            row[j] += row[j - 1];
+    }
+
+    float sum = 0.0f;
+    for (float w : row)
+        sum += w;
+
+    std::vector<float> kernel;
+    kernel.reserve(size * size);
+    for (float wy : row)
+        for (float wx : row)
+            kernel.push_back(wx * wy / (sum * sum));
+    return kernel;
+}
+
+PostProcessor::PostProcessor() {
+    glGenVertexArrays(1, &empty_vao);
+}
+
+PostProcessor::~PostProcessor() {
+    for (auto& [source, program] : programs)
+        glDeleteProgram(program->ID);
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+void PostProcessor::clear() {
+    passes.clear();
+}
+
+void PostProcessor::addKernel(const std::vector<float>& kernel, float stride) {
+    int size = static_cast<int>(std::lround(std::sqrt(static_cast<float>(kernel.size()))));
+    if (size * size != static_cast<int>(kernel.size()) || size % 2 == 0) {
+        std::cout << "ERROR::POST_PROCESSING:: Kernel must be square with an odd size" << std::endl;
+        return;
+    }
+
+    // The largest weight is the most stable pivot for a rank 1 factorization
+    int pivot = 0;
+    for (int i = 1; i < size * size; i++) {
+        if (std::abs(kernel[i]) > std::abs(kernel[pivot]))
+            pivot = i;
+    }
+    float scale = kernel[pivot];
+    if (scale == 0.0f)
+        return;
+
+    int pivot_row = pivot / size, pivot_col = pivot % size;
+    std::vector<float> kernel_x(size), kernel_y(size);
+    for (int i = 0; i < size; i++) {
+        kernel_x[i] = kernel[pivot_row * size + i] / scale;
+        kernel_y[i] = kernel[i * size + pivot_col];
+    }
+
+    bool separable = true;
+    for (int y = 0; y < size && separable; y++)
+        for (int x = 0; x < size && separable; x++)
+            separable = std::abs(kernel[y * size + x] - kernel_x[x] * kernel_y[y]) <= 1e-5f * std::abs(scale);
+
+    if (separable) {
+        addSeparable(kernel_x, kernel_y, stride);
+        return;
+    }
+
+    Pass pass;
+    int half = size / 2;
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            float weight = kernel[y * size + x];
+            if (weight == 0.0f)
+                continue;
+            pass.offsets.push_back(glm::vec2(x - half, half - y) * stride);
+            pass.weights.push_back(weight);
+        }
+    }
+    passes.push_back(pass);
+}
+
+void PostProcessor::addSeparable(const std::vector<float>& kernel_x, const std::vector<float>& kernel_y, float stride) {
+    addAxis(kernel_x, glm::vec2(stride, 0.0f));
+    // Rows are listed top first, so the vertical kernel walks down
+    addAxis(kernel_y, glm::vec2(0.0f, -stride));
+}
+
+void PostProcessor::addGaussianBlur(float sigma, float stride) {
+    int radius = std::max(1, static_cast<int>(std::ceil(3.0f * sigma)));
+    std::vector<float> kernel(2 * radius + 1);
+    float sum = 0.0f;
+    for (int i = -radius; i <= radius; i++) {
+        kernel[i + radius] = std::exp(-0.5f * i * i / (sigma * sigma));
+        sum += kernel[i + radius];
+    }
+    for (float& w : kernel)
+        w /= sum;
+    addSeparable(kernel, kernel, stride);
+}
+
+void PostProcessor::addAxis(const std::vector<float>& kernel, const glm::vec2& axis) {
+    Pass pass;
+    int radius = static_cast<int>(kernel.size()) / 2;
+    if (kernel[radius] != 0.0f) {
+        pass.offsets.push_back(glm::vec2(0.0f));
+        pass.weights.push_back(kernel[radius]);
+    }
+
+    // Walking outwards from the center, neighbouring weights of the same sign are merged into one fetch placed
+    // between the two texels so that bilinear filtering reproduces their weighted sum. That only holds for taps one
+    // source texel apart, other strides fetch every tap on its own.
+    bool merge = std::abs(axis.x) + std::abs(axis.y) == 1.0f;
+    for (int side : { -1, 1 }) {
+        for (int i = 1; i <= radius;) {
+            float a = kernel[radius + side * i];
+            float b = i < radius ? kernel[radius + side * (i + 1)] : 0.0f;
+            if (merge && i < radius && a * b >= 0.0f && a + b != 0.0f) {
+                pass.offsets.push_back(axis * (side * (i * a + (i + 1) * b) / (a + b)));
+                pass.weights.push_back(a + b);
+                i += 2;
+                continue;
+            }
+            if (a != 0.0f) {
+                pass.offsets.push_back(axis * static_cast<float>(side * i));
+                pass.weights.push_back(a);
+            }
+            i++;
+        }
+    }
+    passes.push_back(pass);
+}
+
+void PostProcessor::addPointwise(const std::string& code, const glm::vec4& params) {
+    // Per-pixel operations run at the end of the previous pass instead of costing a pass of their own
+    if (passes.empty())
+        passes.push_back(Pass());
+    passes.back().ops.push_back({ code, params });
+}
+
+Shader& PostProcessor::getProgram(const Pass& pass) {
+    std::string source = "#version 330 core\nout vec4 frag_color;\n\nin vec2 tex_coord;\n\nuniform sampler2D source;\n";
+    if (!pass.weights.empty())
+        source += std::format("uniform vec2 tap_offsets[{0}];\nuniform float tap_weights[{0}];\n", pass.weights.size());
+    if (!pass.ops.empty())
+        source += std::format("uniform vec4 op_params[{}];\n", pass.ops.size());
+
+    source += "\nvoid main() {\n";
+    if (pass.weights.empty())
+        source += "    vec3 color = texture(source, tex_coord).rgb;\n";
+    else {
+        source += "    vec3 color = vec3(0.0);\n";
+        source += std::format("    for (int i = 0; i < {}; i++)\n", pass.weights.size());
+        source += "        color += texture(source, tex_coord + tap_offsets[i]).rgb * tap_weights[i];\n";
+    }
+    for (size_t i = 0; i < pass.ops.size(); i++)
+        source += std::format("    {{\n        vec4 params = op_params[{}];\n        {}\n    }}\n", i, pass.ops[i].code);
+    source += "    frag_color = vec4(color, 1.0);\n}\n";
+
+    auto program = programs.find(source);
+    if (program == programs.end()) {
+        program = programs.emplace(source, Shader::fromSource(FULLSCREEN_VERT, source)).first;
+        stats.compiled++;
+    }
+    return *program->second;
+}
+
+void PostProcessor::run(const Pass& pass, GLuint input, const glm::vec2& texel) {
+    GLint polygon_mode[2];
+    glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+    glBindVertexArray(empty_vao);
+    glActiveTexture(GL_TEXTURE0);
+
+    Shader& program = getProgram(pass);
+    program.use();
+    program.setInt("source", 0);
+    for (size_t i = 0; i < pass.weights.size(); i++) {
+        program.setVec2(std::format("tap_offsets[{}]", i), pass.offsets[i] * texel);
+        program.setFloat(std::format("tap_weights[{}]", i), pass.weights[i]);
+    }
+    for (size_t i = 0; i < pass.ops.size(); i++)
+        program.setVec4(std::format("op_params[{}]", i), pass.ops[i].params);
+
+    glBindTexture(GL_TEXTURE_2D, input);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glBindVertexArray(0);
+    glEnable(GL_STENCIL_TEST);
+    glEnable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, polygon_mode[0]);
+}
+
+void PostProcessor::addPasses(FrameGraph& graph, FrameResource input, FrameResource output) {
+    // An empty chain is a plain copy
+    if (passes.empty())
+        passes.push_back(Pass());
+
+    stats.passes = static_cast<unsigned int>(passes.size());
+    stats.taps = 0;
+
+    // Intermediate passes ping-pong through transient textures, the graph aliases them with each other and with
+    // the input once it is no longer read
+    TextureDesc desc = graph.getDesc(input);
+    glm::vec2 texel(1.0f / desc.width, 1.0f / desc.height);
+    desc.format = GL_RGB8;
+    for (size_t p = 0; p < passes.size(); p++) {
+        FrameResource target = p + 1 == passes.size() ? output : graph.create("Post-processing", desc);
+        graph.addPass("Post-processing", [this, p, input, texel](FrameGraph& graph) {
+            run(passes[p], graph.getTexture(input), texel);
+        }).read(input).write(target);
+
+        stats.taps += static_cast<unsigned int>(std::max<size_t>(1, passes[p].weights.size()));
+        input = target;
+    }
+}
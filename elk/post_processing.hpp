@@ -0,0 +1,82 @@
+#ifndef POST_PROCESSING_H
+#define POST_PROCESSING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "frame_graph.hpp"
+#include "shader.hpp"
+
+// Per-pixel snippets for PostProcessor::addPointwise, they modify `vec3 color` and read their `vec4 params`
+const char* const POST_GRAYSCALE = "color = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));";
+const char* const POST_INVERT = "color = 1.0 - color;";
+const char* const POST_EXPOSURE = "color *= params.x;";
+const char* const POST_GAMMA = "color = pow(max(color, 0.0), vec3(1.0 / params.x));";
+
+// Square kernels in row-major order, top row first
+std::vector<float> getSharpenKernel(float strength, bool detect_edges = false);
+std::vector<float> getBinomialKernel(int size);
+
+struct PostStats {
+    unsigned int passes = 0;
+    unsigned int taps = 0;
+    unsigned int compiled = 0;
+};
+
+// Post-processing chain built at runtime. Separable kernels are split into two 1D passes whose taps are, at stride
+// 1, pairwise merged into single bilinear fetches, consecutive per-pixel operations are fused into the preceding
+// pass and every pass is generated as GLSL and cached by its source, so rebuilding the chain every frame is cheap.
+// Intermediate textures come from the frame graph.
+class PostProcessor {
+public:
+    PostProcessor();
+    ~PostProcessor();
+
+    void clear();
+
+    // Rank 1 kernels are detected and split, others are sampled with one fetch per non-zero weight
+    void addKernel(const std::vector<float>& kernel, float stride = 1.0f);
+    void addSeparable(const std::vector<float>& kernel_x, const std::vector<float>& kernel_y, float stride = 1.0f);
+    void addGaussianBlur(float sigma, float stride = 1.0f);
+    void addPointwise(const std::string& code, const glm::vec4& params = glm::vec4(0.0f));
+
+    // Adds the chain's passes, reading input and writing output
+    void addPasses(FrameGraph& graph, FrameResource input, FrameResource output);
+
+    const PostStats& getStats() const {
+        return stats;
+    }
+
+    size_t getProgramCount() const {
+        return programs.size();
+    }
+
+private:
+    struct PointOp {
+        std::string code;
+        glm::vec4 params;
+    };
+
+    // Taps are in texels, a pass without taps fetches its input once
+    struct Pass {
+        std::vector<glm::vec2> offsets;
+        std::vector<float> weights;
+        std::vector<PointOp> ops;
+    };
+
+    std::vector<Pass> passes;
+    std::unordered_map<std::string, std::unique_ptr<Shader>> programs;
+    GLuint empty_vao;
+    PostStats stats;
+
+    void addAxis(const std::vector<float>& kernel, const glm::vec2& axis);
+    Shader& getProgram(const Pass& pass);
+    void run(const Pass& pass, GLuint input, const glm::vec2& texel);
+};
+
+#endif // !POST_PROCESSING_H
@@ -9,6 +9,14 @@
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <array>
+#include <cstring>
+
+struct UniformStats {
+    unsigned int issued = 0;
+    unsigned int skipped = 0;
+};
 
 class Shader
 {
@@ -40,28 +48,42 @@ public:
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
 
-        const char* vert_code = vert_buf.c_str();
-        const char* frag_code = frag_buf.c_str();
+        build(vert_buf.c_str(), frag_buf.c_str());
+    }
 
-        GLuint vertex, fragment;
+    // Compiles a program from GLSL source held in memory, e.g. generated at runtime
+    static std::unique_ptr<Shader> fromSource(const std::string& vert_code, const std::string& frag_code) {
+        std::unique_ptr<Shader> shader(new Shader());
+        shader->build(vert_code.c_str(), frag_code.c_str());
+        return shader;
+    }
 
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vert_code, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
+    // Compute program, only on contexts with GL 4.3
+    explicit Shader(const char* comp_path) : ID(glCreateProgram()) {
+        std::string comp_buf;
+        std::ifstream comp_file;
+        comp_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try {
+            comp_file.open(comp_path);
+            std::stringstream comp_stream;
+            comp_stream << comp_file.rdbuf();
+            comp_file.close();
+            comp_buf = comp_stream.str();
+        }
+        catch (std::ifstream::failure& e) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        }
 
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &frag_code, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
+        const char* comp_code = comp_buf.c_str();
+        GLuint compute = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(compute, 1, &comp_code, NULL);
+        glCompileShader(compute);
+        checkCompileErrors(compute, "COMPUTE");
 
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
+        glAttachShader(ID, compute);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
-
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
+        glDeleteShader(compute);
     }
 
     void use() const {
@@ -73,145 +95,144 @@ public:
     }
 
     void setInt(const std::string& name, int value) {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniform1i(loc->second, value);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniform1i(new_loc, value);
-        }
+        UniformSlot& slot = getSlot(name);
+        if (shadow(slot, &value, sizeof(value)))
+            glUniform1i(slot.loc, value);
     }
 
     void setFloat(const std::string& name, float value) {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniform1f(loc->second, value);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniform1f(new_loc, value);
-        }
+        UniformSlot& slot = getSlot(name);
+        if (shadow(slot, &value, sizeof(value)))
+            glUniform1f(slot.loc, value);
     }
 
     void setVec2(const std::string& name, const glm::vec2& value)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniform2fv(loc->second, 1, &value[0]);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniform2fv(new_loc, 1, &value[0]);
-        }
+        UniformSlot& slot = getSlot(name);
+        if (shadow(slot, &value[0], sizeof(value)))
+            glUniform2fv(slot.loc, 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniform2f(loc->second, x, y);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniform2f(new_loc, x, y);
-        }
+        setVec2(name, glm::vec2(x, y));
     }
 
     void setVec3(const std::string& name, const glm::vec3& value)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniform3fv(loc->second, 1, &value[0]);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniform3fv(new_loc, 1, &value[0]);
-        }
+        UniformSlot& slot = getSlot(name);
+        if (shadow(slot, &value[0], sizeof(value)))
+            glUniform3fv(slot.loc, 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniform3f(loc->second, x, y, z);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniform3f(new_loc, x, y, z);
-        }
+        setVec3(name, glm::vec3(x, y, z));
     }
 
     void setVec4(const std::string& name, const glm::vec4& value)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniform4fv(loc->second, 1, &value[0]);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniform4fv(new_loc, 1, &value[0]);
-        }
+        UniformSlot& slot = getSlot(name);
+        if (shadow(slot, &value[0], sizeof(value)))
+            glUniform4fv(slot.loc, 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniform4f(loc->second, x, y, z, w);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniform4f(new_loc, x, y, z, w);
-        }
+        setVec4(name, glm::vec4(x, y, z, w));
     }
 
     void setMat2(const std::string& name, const glm::mat2& mat)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniformMatrix2fv(loc->second, 1, GL_FALSE, &mat[0][0]);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniformMatrix2fv(new_loc, 1, GL_FALSE, &mat[0][0]);
-        }
+        UniformSlot& slot = getSlot(name);
+        if (shadow(slot, &mat[0][0], sizeof(mat)))
+            glUniformMatrix2fv(slot.loc, 1, GL_FALSE, &mat[0][0]);
     }
 
     void setMat3(const std::string& name, const glm::mat3& mat)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniformMatrix3fv(loc->second, 1, GL_FALSE, &mat[0][0]);
-        }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniformMatrix3fv(new_loc, 1, GL_FALSE, &mat[0][0]);
-        }
+        UniformSlot& slot = getSlot(name);
+        if (shadow(slot, &mat[0][0], sizeof(mat)))
+            glUniformMatrix3fv(slot.loc, 1, GL_FALSE, &mat[0][0]);
     }
 
     void setMat4(const std::string& name, const glm::mat4& mat)
     {
-        auto loc = lut.find(name);
-        if (loc != lut.end()) {
-            glUniformMatrix4fv(loc->second, 1, GL_FALSE, &mat[0][0]);
+        UniformSlot& slot = getSlot(name);
+        if (shadow(slot, &mat[0][0], sizeof(mat)))
+            glUniformMatrix4fv(slot.loc, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // Points the named uniform block at a binding index, programs without the block are left alone
+    void bindUniformBlock(const std::string& name, GLuint binding) const {
+        GLuint index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
+    }
+
+    // Upload counters shared by all programs, reset once per frame by the caller
+    static UniformStats& getUniformStats() {
+        static UniformStats stats;
+        return stats;
+    }
+
+    static void resetUniformStats() {
+        getUniformStats() = UniformStats();
+    }
+
+private:
+    Shader() : ID(glCreateProgram()) {}
+
+    // CPU-side copy of the last value uploaded to each uniform, large enough for a mat4
+    struct UniformSlot {
+        GLint loc = -1;
+        bool valid = false;
+        std::array<GLfloat, 16> value{};
+    };
+
+    std::map<const std::string, UniformSlot> lut;
+
+    UniformSlot& getSlot(const std::string& name) {
+        auto slot = lut.find(name);
+        if (slot == lut.end()) {
+            UniformSlot new_slot;
+            new_slot.loc = glGetUniformLocation(ID, name.c_str());
+            slot = lut.emplace(name, new_slot).first;
         }
-        else {
-            GLuint new_loc = glGetUniformLocation(ID, name.c_str());
-            lut[name] = new_loc;
-            glUniformMatrix4fv(new_loc, 1, GL_FALSE, &mat[0][0]);
+        return slot->second;
+    }
+
+    // Returns true when the value differs from the shadow copy and needs a glUniform* call
+    bool shadow(UniformSlot& slot, const void* value, size_t size) {
+        UniformStats& stats = getUniformStats();
+        if (slot.loc == -1 || (slot.valid && std::memcmp(slot.value.data(), value, size) == 0)) {
+            stats.skipped++;
+            return false;
         }
+        std::memcpy(slot.value.data(), value, size);
+        slot.valid = true;
+        stats.issued++;
+        return true;
     }
 
-private:
-    std::map<const std::string, GLuint> lut;
+    void build(const char* vert_code, const char* frag_code) {
+        GLuint vertex, fragment;
+
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vert_code, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &frag_code, NULL);
+        glCompileShader(fragment);
+        checkCompileErrors(fragment, "FRAGMENT");
+
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+    }
 
     void checkCompileErrors(GLuint shader, std::string type)
     {
@@ -0,0 +1,10 @@
+#version 330 core
+
+const vec2 quad_vertices[4] = vec2[4]( vec2( -1.0, -1.0), vec2( 1.0, -1.0), vec2( -1.0, 1.0), vec2( 1.0, 1.0));
+
+out vec2 tex_coord;
+
+void main() {
+    gl_Position = vec4(quad_vertices[gl_VertexID], 0.0, 1.0);
+    tex_coord = quad_vertices[gl_VertexID] * 0.5 + 0.5;
+}
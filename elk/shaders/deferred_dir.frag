@@ -0,0 +1,135 @@
+#version 330 core
+struct SpotLight {
+	vec4 pos;
+	vec4 dir;
+	float soft_cutoff;
+	float cutoff;
+	
+	vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+
+	vec3 visibility;
+};
+
+struct DirLight {
+	vec4 dir;
+	
+	vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+struct GBuffer {
+	sampler2D albedo_spec;
+	sampler2D normal;
+	sampler2D depth;
+};
+
+struct Material {
+    float shininess;
+};
+
+out vec4 frag_color;
+
+in vec2 tex_coord;
+
+uniform mat4 view;
+uniform mat4 inv_proj;
+
+uniform SpotLight spot_light;
+uniform DirLight dir_light;
+uniform GBuffer gbuffer;
+uniform Material material;
+
+// Cascaded shadow maps of the directional light, see CascadedShadowMap
+uniform sampler2DArrayShadow shadow_map;
+uniform mat4 shadow_matrices[4];
+uniform vec4 shadow_splits;
+uniform vec4 shadow_offsets;
+uniform int shadow_cascades;
+uniform float shadow_texel;
+
+vec4 pos;
+vec4 norm;
+
+vec4 calcSpotLight(SpotLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s);
+vec4 calcDirLight(DirLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s);
+float calcShadow();
+
+vec3 decodeNormal(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+void main() {
+	float depth = texture(gbuffer.depth, tex_coord).r;
+	if (depth == 1.0) discard;
+
+	vec4 view_pos = inv_proj * vec4(vec3(tex_coord, depth) * 2.0 - 1.0, 1.0);
+	pos = vec4(view_pos.xyz / view_pos.w, 1.0);
+	norm = vec4(decodeNormal(texture(gbuffer.normal, tex_coord).xy), 0.0);
+
+	vec4 albedo_spec = texture(gbuffer.albedo_spec, tex_coord);
+	vec4 diffuse_s = vec4(albedo_spec.rgb, 1.0);
+	vec4 specular_s = vec4(vec3(albedo_spec.a), 1.0);
+
+	frag_color = calcSpotLight(spot_light, specular_s, diffuse_s, diffuse_s) + calcDirLight(dir_light, specular_s, diffuse_s, diffuse_s);
+}
+
+vec4 calcSpotLight(SpotLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s) {
+	vec4 ray = pos - light.pos;
+	vec4 light_dir = normalize(ray);
+	vec4 reflect_dir = reflect(light_dir, norm);
+
+	float diff = max(dot(norm, -light_dir), 0.0);
+	float spec = pow(max(dot(normalize(-pos), reflect_dir), 0.0), material.shininess);
+
+	vec4 ambient  = light.ambient  * (ambient_s);
+	vec4 diffuse  = light.diffuse  * (diffuse_s  * diff);
+	vec4 specular = light.specular * (specular_s * spec);
+
+	float attenuation = 1.0 / (
+		light.visibility.x + 
+		light.visibility.y * length(ray) + 
+		light.visibility.z * length(ray) * length(ray)
+	);
+
+	float val = dot(light_dir, light.dir);
+	float I = clamp((val-light.cutoff)/(light.soft_cutoff-light.cutoff), 0.0, 1.0);
+
+	return (ambient + diffuse + specular) * attenuation * I;
+}
+
+vec4 calcDirLight(DirLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s) {
+	vec4 light_dir = -normalize(view * light.dir);
+	vec4 reflect_dir = reflect(-light_dir, norm);
+
+	float diff = max(dot(norm, light_dir), 0.0);
+	float spec = pow(max(dot(normalize(-pos), reflect_dir), 0.0), 3.0);
+
+	vec4 ambient  = light.ambient  * (ambient_s);
+	vec4 diffuse  = light.diffuse  * (diffuse_s  * diff);
+	vec4 specular = light.specular * (specular_s * spec);
+
+	return ambient + (diffuse + specular) * calcShadow();
+}
+
+float calcShadow() {
+	int cascade = 0;
+	while (cascade < shadow_cascades && -pos.z > shadow_splits[cascade]) cascade++;
+	if (cascade >= shadow_cascades) return 1.0;
+
+	vec4 light_pos = shadow_matrices[cascade] * (pos + norm * shadow_offsets[cascade]);
+	vec3 coord = light_pos.xyz / light_pos.w * 0.5 + 0.5;
+	if (coord.z > 1.0) return 1.0;
+
+	// 3x3 PCF on top of the hardware 2x2 comparison filter
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++)
+		for (int y = -1; y <= 1; y++)
+			lit += texture(shadow_map, vec4(coord.xy + vec2(x, y) * shadow_texel, cascade, coord.z));
+	return lit / 9.0;
+}
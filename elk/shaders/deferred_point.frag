@@ -0,0 +1,66 @@
+#version 330 core
+struct GBuffer {
+	sampler2D albedo_spec;
+	sampler2D normal;
+	sampler2D depth;
+};
+
+struct Material {
+    float shininess;
+};
+
+out vec4 frag_color;
+
+flat in vec4 light_pos;
+flat in vec4 light_ambient;
+flat in vec4 light_diffuse;
+flat in vec4 light_specular;
+flat in vec3 light_visibility;
+
+uniform mat4 inv_proj;
+uniform vec2 screen_size;
+
+uniform GBuffer gbuffer;
+uniform Material material;
+
+vec3 decodeNormal(vec2 e) {
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+void main() {
+	vec2 tex_coord = gl_FragCoord.xy / screen_size;
+	float depth = texture(gbuffer.depth, tex_coord).r;
+
+	vec4 view_pos = inv_proj * vec4(vec3(tex_coord, depth) * 2.0 - 1.0, 1.0);
+	vec4 pos = vec4(view_pos.xyz / view_pos.w, 1.0);
+
+	vec4 ray = vec4(light_pos.xyz, 1.0) - pos;
+	float dist = length(ray);
+	if (dist > light_pos.w) discard;
+
+	vec4 norm = vec4(decodeNormal(texture(gbuffer.normal, tex_coord).xy), 0.0);
+	vec4 albedo_spec = texture(gbuffer.albedo_spec, tex_coord);
+	vec4 diffuse_s = vec4(albedo_spec.rgb, 1.0);
+	vec4 specular_s = vec4(vec3(albedo_spec.a), 1.0);
+
+	vec4 light_dir = ray / dist;
+	vec4 reflect_dir = reflect(-light_dir, norm);
+
+	float diff = max(dot(norm, light_dir), 0.0);
+	float spec = pow(max(dot(normalize(-pos), reflect_dir), 0.0), material.shininess);
+
+	vec4 ambient  = light_ambient  * (diffuse_s);
+	vec4 diffuse  = light_diffuse  * (diffuse_s  * diff);
+	vec4 specular = light_specular * (specular_s * spec);
+
+	float attenuation = 1.0 / (
+		light_visibility.x + 
+		light_visibility.y * dist + 
+		light_visibility.z * dist * dist
+	);
+
+	frag_color = (ambient + diffuse + specular) * attenuation;
+}
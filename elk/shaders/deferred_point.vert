@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aPosRadius;
+layout (location = 2) in vec4 aAmbient;
+layout (location = 3) in vec4 aDiffuse;
+layout (location = 4) in vec4 aSpecular;
+layout (location = 5) in vec4 aVisibility;
+
+flat out vec4 light_pos;
+flat out vec4 light_ambient;
+flat out vec4 light_diffuse;
+flat out vec4 light_specular;
+flat out vec3 light_visibility;
+
+uniform mat4 proj;
+
+void main() {
+	// Light volumes are placed directly in view space
+	gl_Position = proj * vec4(aPosRadius.xyz + aPos * aPosRadius.w, 1.0);
+
+	light_pos = aPosRadius;
+	light_ambient = aAmbient;
+	light_diffuse = aDiffuse;
+	light_specular = aSpecular;
+	light_visibility = aVisibility.xyz;
+}
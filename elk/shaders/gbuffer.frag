@@ -0,0 +1,32 @@
+#version 330 core
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    float shininess;
+};
+
+layout (location = 0) out vec4 albedo_spec;
+layout (location = 1) out vec2 packed_normal;
+
+in vec4 pos;
+in vec4 normal;
+in vec2 tex_coord;
+
+uniform Material material;
+
+// Octahedral mapping of a unit vector to [-1, 1]^2
+vec2 octWrap(vec2 v) {
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	return n.z >= 0.0 ? n.xy : octWrap(n.xy);
+}
+
+void main() {
+	vec4 diffuse_s = texture(material.texture_diffuse1, tex_coord);
+	if (diffuse_s.a < 0.1) discard;
+	albedo_spec = vec4(diffuse_s.rgb, texture(material.texture_specular1, tex_coord).r);
+	packed_normal = encodeNormal(normalize(normal.xyz));
+}
@@ -0,0 +1,13 @@
+#version 330 core
+in vec3 normal;
+in vec4 color;
+
+out vec4 frag_color;
+
+// View space direction the light travels in
+uniform vec3 light_dir;
+
+void main() {
+	float diffuse = max(dot(normalize(normal), -normalize(light_dir)), 0.0);
+	frag_color = vec4(color.rgb * (0.2 + 0.8 * diffuse), 1.0);
+}
\ No newline at end of file
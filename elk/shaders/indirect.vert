@@ -0,0 +1,38 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+// Instanced, so it is fetched at the command's base instance
+layout (location = 3) in uint aDrawId;
+
+out vec3 normal;
+out vec4 color;
+
+layout (std140) uniform CameraBlock {
+	mat4 proj;
+	mat4 view;
+};
+
+struct Draw {
+	uint transform;
+	uint material;
+	uint mesh;
+	uint pad;
+};
+
+layout (std430, binding = 0) readonly buffer Transforms {
+	mat4 transforms[];
+};
+layout (std430, binding = 1) readonly buffer Draws {
+	Draw draws[];
+};
+layout (std430, binding = 2) readonly buffer Materials {
+	vec4 materials[];
+};
+
+void main() {
+	Draw draw = draws[aDrawId];
+	mat4 model_view = view * transforms[draw.transform];
+	gl_Position = proj * model_view * vec4(aPos, 1.0);
+	normal = mat3(model_view) * aNormal;
+	color = materials[draw.material];
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+
+out vec3 normal;
+out vec4 color;
+
+uniform mat4 model;
+uniform vec4 material_color;
+
+layout (std140) uniform CameraBlock {
+	mat4 proj;
+	mat4 view;
+};
+
+void main() {
+	mat4 model_view = view * model;
+	gl_Position = proj * model_view * vec4(aPos, 1.0);
+	normal = mat3(model_view) * aNormal;
+	color = material_color;
+}
\ No newline at end of file
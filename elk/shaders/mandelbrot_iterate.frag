@@ -0,0 +1,29 @@
+#version 330 core
+out float iterations;
+
+uniform vec2 center;
+uniform float pixel_size;
+uniform float half_size;
+uniform int max_iterations;
+
+void main() {
+    vec2 c = center + (gl_FragCoord.xy - half_size) * pixel_size;
+
+    // The main cardioid and the period 2 bulb never escape
+    vec2 d = c - vec2(0.25, 0.0);
+    float q = dot(d, d);
+    if (q * (q + d.x) <= 0.25 * c.y * c.y || dot(c + vec2(1.0, 0.0), c + vec2(1.0, 0.0)) <= 0.0625) {
+        iterations = -1.0;
+        return;
+    }
+
+    vec2 z = vec2(0.0);
+    int i = 0;
+    while (dot(z, z) <= 16.0 && i < max_iterations) {
+        z = vec2(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y) + c;
+        i++;
+    }
+
+    // Continuous count for escaped points, negative inside the set
+    iterations = i < max_iterations ? float(i) + 1.0 - log2(0.5 * log2(dot(z, z))) : -1.0;
+}
@@ -0,0 +1,69 @@
+#version 330 core
+out float iterations;
+
+// Reference orbit Z_n of the view center
+uniform samplerBuffer orbit;
+uniform int orbit_length;
+uniform int max_iterations;
+uniform float half_size;
+uniform float pixel_mantissa;
+uniform int pixel_exponent;
+
+// Offset after skip iterations is a dc + b dc^2 + c dc^3, coefficients are mantissa * 2^exponent
+uniform int skip;
+uniform vec2 series_a, series_b, series_c;
+uniform int series_exponents[3];
+
+vec2 mul(vec2 a, vec2 b) {
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+void main() {
+    // Offsets are w * 2^e, so they stay representable for pixel sizes far below float range
+    vec2 dc = (gl_FragCoord.xy - half_size) * pixel_mantissa;
+    int dc_exponent = pixel_exponent;
+
+    vec2 w = vec2(0.0);
+    int e = dc_exponent;
+    if (skip > 0) {
+        vec2 dc2 = mul(dc, dc);
+        e = series_exponents[0] + dc_exponent;
+        w = mul(series_a, dc)
+            + mul(series_b, dc2) * exp2(float(series_exponents[1] + dc_exponent - series_exponents[0]))
+            + mul(series_c, mul(dc2, dc)) * exp2(float(series_exponents[2] + 2 * dc_exponent - series_exponents[0]));
+    }
+
+    int n = skip;
+    int i = skip;
+    vec2 z = texelFetch(orbit, n).xy;
+    while (i < max_iterations) {
+        // d_n+1 = 2 Z_n d_n + d_n^2 + dc
+        vec2 reference = texelFetch(orbit, n).xy;
+        w = 2.0 * mul(reference, w) + mul(w, w) * exp2(float(e)) + dc * exp2(float(dc_exponent - e));
+        n++;
+        i++;
+
+        float magnitude = max(abs(w.x), abs(w.y));
+        if (magnitude > 65536.0 || (magnitude > 0.0 && magnitude < 1.0 / 65536.0)) {
+            int k = int(floor(log2(magnitude)));
+            w *= exp2(float(-k));
+            e += k;
+        }
+
+        vec2 delta = w * exp2(float(e));
+        z = texelFetch(orbit, n).xy + delta;
+        if (dot(z, z) > 16.0)
+            break;
+
+        // Close to zero the offset dominates and precision is lost, continuing from the start of the orbit with the
+        // full value avoids the glitch, as does running past the end of the orbit
+        if (dot(z, z) < dot(delta, delta) || n == orbit_length - 1) {
+            w = z;
+            e = 0;
+            n = 0;
+        }
+    }
+
+    // Continuous count for escaped points, negative inside the set
+    iterations = i < max_iterations ? float(i) + 1.0 - log2(0.5 * log2(dot(z, z))) : -1.0;
+}
@@ -0,0 +1,12 @@
+#version 330 core
+out float iterations;
+
+uniform sampler2D previous;
+uniform float scale;
+uniform vec2 offset;
+
+void main() {
+    ivec2 texel = ivec2(floor(gl_FragCoord.xy * scale + offset));
+    bool inside = all(greaterThanEqual(texel, ivec2(0))) && all(lessThan(texel, textureSize(previous, 0)));
+    iterations = inside ? texelFetch(previous, texel, 0).r : -2.0;
+}
@@ -1,8 +0,0 @@
-#version 330 core
-out vec4 frag_color;
-
-in vec4 normal;
-
-void main() {
-    frag_color = vec4(0.7, 0.7, 0.7, 1.0);
-}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 330 core
+out vec4 frag_color;
+
+uniform isampler2D seeds;
+uniform float outline_width;
+uniform vec4 outline_color;
+
+void main() {
+    ivec2 seed = texelFetch(seeds, ivec2(gl_FragCoord.xy), 0).xy;
+    if (seed.x < 0)
+        discard;
+
+    // One pixel of coverage falloff keeps the edge antialiased
+    float dist = length(vec2(seed) + 0.5 - gl_FragCoord.xy);
+    float coverage = clamp(outline_width - dist + 0.5, 0.0, 1.0);
+    if (coverage <= 0.0)
+        discard;
+    frag_color = vec4(outline_color.rgb, outline_color.a * coverage);
+}
@@ -0,0 +1,31 @@
+#version 330 core
+out ivec2 seed;
+
+uniform isampler2D seeds;
+uniform int jump;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 size = textureSize(seeds, 0);
+
+    seed = ivec2(-1);
+    float best = 1e20;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 coord = pixel + ivec2(x, y) * jump;
+            if (any(lessThan(coord, ivec2(0))) || any(greaterThanEqual(coord, size)))
+                continue;
+
+            ivec2 candidate = texelFetch(seeds, coord, 0).xy;
+            if (candidate.x < 0)
+                continue;
+
+            vec2 offset = vec2(candidate - pixel);
+            float dist = dot(offset, offset);
+            if (dist < best) {
+                best = dist;
+                seed = candidate;
+            }
+        }
+    }
+}
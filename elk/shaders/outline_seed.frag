@@ -0,0 +1,7 @@
+#version 330 core
+out ivec2 seed;
+
+void main() {
+    // Only runs where the stencil mask is set
+    seed = ivec2(gl_FragCoord.xy);
+}
@@ -52,11 +52,20 @@ uniform SpotLight spot_light;
 uniform DirLight dir_light;
 uniform Material material;
 
+// Cascaded shadow maps of the directional light, see CascadedShadowMap
+uniform sampler2DArrayShadow shadow_map;
+uniform mat4 shadow_matrices[4];
+uniform vec4 shadow_splits;
+uniform vec4 shadow_offsets;
+uniform int shadow_cascades;
+uniform float shadow_texel;
+
 vec4 norm = normalize(normal);
 
 vec4 calcPointLight(PointLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s);
 vec4 calcSpotLight(SpotLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s);
 vec4 calcDirLight(DirLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s);
+float calcShadow();
 
 void main() {
 	vec4 diffuse_s  =  texture(material.texture_diffuse1, tex_coord);
@@ -126,5 +135,22 @@ vec4 calcDirLight(DirLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_
 	vec4 diffuse  = light.diffuse  * (diffuse_s  * diff);
 	vec4 specular = light.specular * (specular_s * spec);
 
-	return ambient + diffuse + specular;
+	return ambient + (diffuse + specular) * calcShadow();
+}
+
+float calcShadow() {
+	int cascade = 0;
+	while (cascade < shadow_cascades && -pos.z > shadow_splits[cascade]) cascade++;
+	if (cascade >= shadow_cascades) return 1.0;
+
+	vec4 light_pos = shadow_matrices[cascade] * (pos + norm * shadow_offsets[cascade]);
+	vec3 coord = light_pos.xyz / light_pos.w * 0.5 + 0.5;
+	if (coord.z > 1.0) return 1.0;
+
+	// 3x3 PCF on top of the hardware 2x2 comparison filter
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++)
+		for (int y = -1; y <= 1; y++)
+			lit += texture(shadow_map, vec4(coord.xy + vec2(x, y) * shadow_texel, cascade, coord.z));
+	return lit / 9.0;
 }
\ No newline at end of file
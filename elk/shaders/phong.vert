@@ -7,9 +7,15 @@ out vec4 pos;
 out vec4 normal;
 out vec2 tex_coord;
 
+invariant gl_Position;
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 proj;
+
+// Shared by the scene programs, streamed once per view with bindCameraBlock
+layout (std140) uniform CameraBlock {
+	mat4 proj;
+	mat4 view;
+};
 
 void main() {
 	gl_Position = proj * view * model * vec4(aPos, 1.0);
@@ -0,0 +1,165 @@
+#version 330 core
+struct SpotLight {
+	vec4 pos;
+	vec4 dir;
+	float soft_cutoff;
+	float cutoff;
+	
+	vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+
+	vec3 visibility;
+};
+
+struct DirLight {
+	vec4 dir;
+	
+	vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+};
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+    float shininess;
+};
+
+out vec4 frag_color;
+
+in vec4 pos;
+in vec4 normal;
+in vec2 tex_coord;
+
+uniform mat4 view;
+
+uniform float time;
+
+// Clustered point lights, see LightClusters
+uniform usamplerBuffer cluster_grid;
+uniform usamplerBuffer light_indices;
+uniform samplerBuffer light_data;
+uniform vec3 cluster_dims;
+uniform vec2 cluster_tile_size;
+uniform float cluster_z_scale;
+uniform float cluster_z_bias;
+
+uniform SpotLight spot_light;
+uniform DirLight dir_light;
+uniform Material material;
+
+// Cascaded shadow maps of the directional light, see CascadedShadowMap
+uniform sampler2DArrayShadow shadow_map;
+uniform mat4 shadow_matrices[4];
+uniform vec4 shadow_splits;
+uniform vec4 shadow_offsets;
+uniform int shadow_cascades;
+uniform float shadow_texel;
+
+vec4 norm = normalize(normal);
+
+vec4 calcPointLight(int light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s);
+vec4 calcSpotLight(SpotLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s);
+vec4 calcDirLight(DirLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s);
+float calcShadow();
+
+void main() {
+	vec4 diffuse_s  =  texture(material.texture_diffuse1, tex_coord);
+	if (diffuse_s.a < 0.1) discard;
+	vec4 specular_s = texture(material.texture_specular1, tex_coord);
+	vec4 spot = calcSpotLight(spot_light, specular_s, diffuse_s, diffuse_s);
+	vec4 dir = calcDirLight(dir_light, specular_s, diffuse_s, diffuse_s);
+	frag_color = spot + dir;
+
+	ivec2 tile = ivec2(gl_FragCoord.xy / cluster_tile_size);
+	int slice = int(log(-pos.z) * cluster_z_scale + cluster_z_bias);
+	ivec3 cluster = clamp(ivec3(tile, slice), ivec3(0), ivec3(cluster_dims) - 1);
+	uvec2 range = texelFetch(cluster_grid, cluster.x + int(cluster_dims.x) * (cluster.y + int(cluster_dims.y) * cluster.z)).xy;
+	for (uint i = 0u; i < range.y; i++) {
+		int light = int(texelFetch(light_indices, int(range.x + i)).x);
+		frag_color += calcPointLight(light, specular_s, diffuse_s, diffuse_s);
+	}
+}
+
+vec4 calcPointLight(int light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s) {
+	// Light positions are already in view space
+	vec4 pos_radius = texelFetch(light_data, light * 5);
+	vec3 visibility = texelFetch(light_data, light * 5 + 4).xyz;
+
+	vec4 ray = vec4(pos_radius.xyz, 1.0) - pos;
+	float dist = length(ray);
+	if (dist > pos_radius.w) return vec4(0.0);
+	vec4 light_dir = ray / dist;
+	vec4 reflect_dir = reflect(-light_dir, norm);
+
+	float diff = max(dot(norm, light_dir), 0.0);
+	float spec = pow(max(dot(normalize(-pos), reflect_dir), 0.0), material.shininess);
+
+	vec4 ambient  = texelFetch(light_data, light * 5 + 1) * (ambient_s);
+	vec4 diffuse  = texelFetch(light_data, light * 5 + 2) * (diffuse_s  * diff);
+	vec4 specular = texelFetch(light_data, light * 5 + 3) * (specular_s * spec);
+
+	float attenuation = 1.0 / (
+		visibility.x + 
+		visibility.y * dist + 
+		visibility.z * dist * dist
+	);
+
+	return (ambient + diffuse + specular) * attenuation;
+}
+
+vec4 calcSpotLight(SpotLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s) {
+	vec4 ray = pos - light.pos;
+	vec4 light_dir = normalize(ray);
+	vec4 reflect_dir = reflect(light_dir, norm);
+
+	float diff = max(dot(norm, -light_dir), 0.0);
+	float spec = pow(max(dot(normalize(-pos), reflect_dir), 0.0), material.shininess);
+
+	vec4 ambient  = light.ambient  * (ambient_s);
+	vec4 diffuse  = light.diffuse  * (diffuse_s  * diff);
+	vec4 specular = light.specular * (specular_s * spec);
+
+	float attenuation = 1.0 / (
+		light.visibility.x + 
+		light.visibility.y * length(ray) + 
+		light.visibility.z * length(ray) * length(ray)
+	);
+
+	float val = dot(light_dir, light.dir);
+	float I = clamp((val-light.cutoff)/(light.soft_cutoff-light.cutoff), 0.0, 1.0);
+
+	return (ambient + diffuse + specular) * attenuation * I;
+}
+
+vec4 calcDirLight(DirLight light, vec4 specular_s, vec4 diffuse_s, vec4 ambient_s) {
+	vec4 light_dir = -normalize(view * light.dir);
+	vec4 reflect_dir = reflect(-light_dir, norm);
+
+	float diff = max(dot(norm, light_dir), 0.0);
+	float spec = pow(max(dot(normalize(-pos), reflect_dir), 0.0), 3.0);
+
+	vec4 ambient  = light.ambient  * (ambient_s);
+	vec4 diffuse  = light.diffuse  * (diffuse_s  * diff);
+	vec4 specular = light.specular * (specular_s * spec);
+
+	return ambient + (diffuse + specular) * calcShadow();
+}
+
+float calcShadow() {
+	int cascade = 0;
+	while (cascade < shadow_cascades && -pos.z > shadow_splits[cascade]) cascade++;
+	if (cascade >= shadow_cascades) return 1.0;
+
+	vec4 light_pos = shadow_matrices[cascade] * (pos + norm * shadow_offsets[cascade]);
+	vec3 coord = light_pos.xyz / light_pos.w * 0.5 + 0.5;
+	if (coord.z > 1.0) return 1.0;
+
+	// 3x3 PCF on top of the hardware 2x2 comparison filter
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++)
+		for (int y = -1; y <= 1; y++)
+			lit += texture(shadow_map, vec4(coord.xy + vec2(x, y) * shadow_texel, cascade, coord.z));
+	return lit / 9.0;
+}
\ No newline at end of file
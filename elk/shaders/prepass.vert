@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+// Must match the main pass transform bit for bit for GL_EQUAL depth testing
+invariant gl_Position;
+
+uniform mat4 model;
+
+// Shared by the scene programs, streamed once per view with bindCameraBlock
+layout (std140) uniform CameraBlock {
+	mat4 proj;
+	mat4 view;
+};
+
+void main() {
+	gl_Position = proj * view * model * vec4(aPos, 1.0);
+}
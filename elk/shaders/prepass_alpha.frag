@@ -0,0 +1,12 @@
+#version 330 core
+struct Material {
+    sampler2D texture_diffuse1;
+};
+
+in vec2 tex_coord;
+
+uniform Material material;
+
+void main() {
+	if (texture(material.texture_diffuse1, tex_coord).a < 0.1) discard;
+}
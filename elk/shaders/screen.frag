@@ -5,36 +5,7 @@ in vec2 tex_coord;
 
 uniform sampler2D screen_texture;
 
-const float offset = 1.0 / 300.0;  
-
 void main()
 {
-    vec2 offsets[9] = vec2[](
-        vec2(-offset,  offset), // top-left
-        vec2( 0.0f,    offset), // top-center
-        vec2( offset,  offset), // top-right
-        vec2(-offset,  0.0f),   // center-left
-        vec2( 0.0f,    0.0f),   // center-center
-        vec2( offset,  0.0f),   // center-right
-        vec2(-offset, -offset), // bottom-left
-        vec2( 0.0f,   -offset), // bottom-center
-        vec2( offset, -offset)  // bottom-right    
-    );
-
-    float kernel[9] = float[](
-        -1, -1, -1,
-        -1,  9, -1,
-        -1, -1, -1
-    );
-    
-    vec3 sample_tex[9];
-    for(int i = 0; i < 9; i++)
-    {
-        sample_tex[i] = vec3(texture(screen_texture, tex_coord.st + offsets[i]));
-    }
-    vec3 col = vec3(0.0);
-    for(int i = 0; i < 9; i++)
-        col += sample_tex[i] * kernel[i];
-    
-    frag_color = vec4(col, 1.0);
-}  
\ No newline at end of file
+    frag_color = vec4(texture(screen_texture, tex_coord).rgb, 1.0);
+}
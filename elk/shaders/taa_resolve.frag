@@ -0,0 +1,62 @@
+#version 330 core
+out vec4 frag_color;
+
+in vec2 tex_coord;
+
+uniform sampler2D scene_color;
+uniform sampler2D scene_depth;
+uniform sampler2D velocity;
+uniform sampler2D history;
+
+// Sub-pixel offset of this frame's samples in render pixels
+uniform vec2 jitter;
+// Unjittered clip space of this frame to the previous one
+uniform mat4 reproject;
+uniform float feedback;
+uniform bool history_valid;
+
+void main() {
+    ivec2 size = textureSize(scene_color, 0);
+
+    // Render texel whose jittered sample lies closest to this pixel, its center shows the scene at center - jitter
+    vec2 pos = tex_coord * vec2(size);
+    ivec2 texel = clamp(ivec2(floor(pos + jitter)), ivec2(0), size - 1);
+    vec2 offset = pos - (vec2(texel) + 0.5 - jitter);
+
+    // Color bounds of the neighbourhood and its closest depth, whose motion moves edges along with the foreground
+    vec3 current = texelFetch(scene_color, texel, 0).rgb;
+    vec3 lo = current, hi = current;
+    float closest = 1.0;
+    ivec2 closest_texel = texel;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            ivec2 neighbour = clamp(texel + ivec2(x, y), ivec2(0), size - 1);
+            vec3 color = texelFetch(scene_color, neighbour, 0).rgb;
+            lo = min(lo, color);
+            hi = max(hi, color);
+            float depth = texelFetch(scene_depth, neighbour, 0).r;
+            if (depth < closest) {
+                closest = depth;
+                closest_texel = neighbour;
+            }
+        }
+    }
+
+    // Pixels without geometry in the velocity pass, like the sky, only move with the camera
+    vec2 motion = texelFetch(velocity, closest_texel, 0).xy;
+    if (motion.x < -1.5) {
+        vec4 prev = reproject * vec4(tex_coord * 2.0 - 1.0, closest * 2.0 - 1.0, 1.0);
+        motion = tex_coord - (prev.xy / prev.w * 0.5 + 0.5);
+    }
+    vec2 prev_coord = tex_coord - motion;
+
+    if (!history_valid || any(lessThan(prev_coord, vec2(0.0))) || any(greaterThan(prev_coord, vec2(1.0)))) {
+        frag_color = vec4(current, 1.0);
+        return;
+    }
+
+    // Samples further from this pixel contribute less, which matters when rendering below output resolution
+    float weight = exp(-2.29 * dot(offset, offset));
+    vec3 previous = clamp(texture(history, prev_coord).rgb, lo, hi);
+    frag_color = vec4(mix(previous, current, (1.0 - feedback) * weight), 1.0);
+}
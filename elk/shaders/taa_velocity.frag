@@ -0,0 +1,20 @@
+#version 330 core
+struct Material {
+    sampler2D texture_diffuse1;
+};
+
+out vec2 velocity;
+
+in vec4 clip_pos;
+in vec4 prev_clip_pos;
+in vec2 tex_coord;
+
+uniform Material material;
+uniform bool alpha_test;
+
+void main() {
+	if (alpha_test && texture(material.texture_diffuse1, tex_coord).a < 0.1) discard;
+
+	// Texture coordinate offset from the previous frame's position
+	velocity = (clip_pos.xy / clip_pos.w - prev_clip_pos.xy / prev_clip_pos.w) * 0.5;
+}
@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 2) in vec2 aTexCoord;
+
+out vec4 clip_pos;
+out vec4 prev_clip_pos;
+out vec2 tex_coord;
+
+// Must match the scene passes for depth testing against their depth
+invariant gl_Position;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 proj;
+
+// Without jitter, so only actual motion ends up in the velocity
+uniform mat4 prev_model;
+uniform mat4 view_proj;
+uniform mat4 prev_view_proj;
+
+void main() {
+	gl_Position = proj * view * model * vec4(aPos, 1.0);
+
+	clip_pos = view_proj * model * vec4(aPos, 1.0);
+	prev_clip_pos = prev_view_proj * prev_model * vec4(aPos, 1.0);
+	tex_coord = aTexCoord;
+}
@@ -0,0 +1,220 @@
+#include "shadows.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <format>
+
+// How far behind a cascade, towards the light, casters are still rendered
+const float CASTER_DISTANCE = 50.0f;
+// Cascades are made this much larger than their frustum slice so they can stay put while the camera moves
+const float CASCADE_PADDING = 1.25f;
+
+CascadedShadowMap::CascadedShadowMap(int nr_cascades, int resolution, float max_distance) :
+    max_distance(max_distance),
+    split_lambda(0.75f),
+    update_threshold(1.0f),
+    nr_cascades(std::clamp(nr_cascades, 1, MAX_CASCADES)),
+    resolution(resolution)
+{
+    cullers.reserve(MAX_CASCADES);
+    for (int i = 0; i < MAX_CASCADES; i++)
+        cullers.emplace_back(std::format("Shadow cascade {}", i));
+
+    glGenFramebuffers(1, &cache_fbo);
+    glGenFramebuffers(1, &shadow_fbo);
+    for (GLuint fbo : { cache_fbo, shadow_fbo }) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    allocate();
+}
+
+CascadedShadowMap::~CascadedShadowMap() {
+    GLuint textures[] = { cache_texture, shadow_texture };
+    GLuint fbos[] = { cache_fbo, shadow_fbo };
+    glDeleteTextures(2, textures);
+    glDeleteFramebuffers(2, fbos);
+}
+
+void CascadedShadowMap::allocate() {
+    if (cache_texture) {
+        GLuint textures[] = { cache_texture, shadow_texture };
+        glDeleteTextures(2, textures);
+    }
+
+    for (GLuint* texture : { &cache_texture, &shadow_texture }) {
+        glGenTextures(1, texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, *texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, nr_cascades, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // Hardware comparison with bilinear filtering, every PCF tap already averages 2x2 texels
+    float border[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    invalidate();
+}
+
+void CascadedShadowMap::configure(int nr_cascades, int resolution) {
+    nr_cascades = std::clamp(nr_cascades, 1, MAX_CASCADES);
+    if (nr_cascades == this->nr_cascades && resolution == this->resolution)
+        return;
+    this->nr_cascades = nr_cascades;
+    this->resolution = resolution;
+    allocate();
+}
+
+void CascadedShadowMap::invalidate() {
+    for (Cascade& cascade : cascades)
+        cascade.valid = false;
+}
+
+void CascadedShadowMap::update(const glm::mat4& view, float fov_y, float aspect, float z_near, const glm::vec3& light_dir) {
+    stats = ShadowStats();
+    inverse_view = glm::inverse(view);
+
+    glm::vec3 dir = glm::normalize(light_dir);
+    float angle = glm::degrees(glm::acos(glm::clamp(glm::dot(dir, this->light_dir), -1.0f, 1.0f)));
+    if (this->light_dir == glm::vec3(0.0f) || angle > update_threshold) {
+        this->light_dir = dir;
+        glm::vec3 up = glm::abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        light_rotation = glm::lookAt(glm::vec3(0.0f), dir, up);
+        invalidate();
+    }
+
+    float tan_y = glm::tan(fov_y * 0.5f), tan_x = tan_y * aspect;
+    float prev_split = z_near;
+    for (int c = 0; c < nr_cascades; c++) {
+        // Blend of logarithmic and uniform splits
+        float t = static_cast<float>(c + 1) / nr_cascades;
+        float split = split_lambda * z_near * glm::pow(max_distance / z_near, t) + (1.0f - split_lambda) * (z_near + (max_distance - z_near) * t);
+
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        int i = 0;
+        for (float d : { prev_split, split })
+            for (float sx : { -1.0f, 1.0f })
+                for (float sy : { -1.0f, 1.0f }) {
+                    glm::vec4 world = inverse_view * glm::vec4(sx * d * tan_x, sy * d * tan_y, -d, 1.0f);
+                    corners[i] = glm::vec3(light_rotation * world);
+                    center += corners[i++] / 8.0f;
+                }
+
+        // The bounding sphere only depends on the projection, so the cascade size stays constant under rotation
+        float radius = 0.0f;
+        for (const glm::vec3& corner : corners)
+            radius = glm::max(radius, glm::length(corner - center));
+        radius = glm::ceil(radius * 16.0f) / 16.0f;
+
+        Cascade& cascade = cascades[c];
+        float extent = radius * CASCADE_PADDING;
+        bool outside = glm::any(glm::greaterThan(glm::abs(center - cascade.center) + radius, glm::vec3(extent)));
+        if (!cascade.valid || extent != cascade.extent || outside) {
+            // Snap to whole texels so re-centering never shifts the rasterization grid
+            float texel = 2.0f * extent / resolution;
+            cascade.center = glm::vec3(glm::floor(glm::vec2(center) / texel) * texel, center.z);
+            cascade.extent = extent;
+            cascade.valid = false;
+
+            glm::mat4 light_view = glm::translate(glm::mat4(1.0f), -cascade.center) * light_rotation;
+            glm::mat4 light_proj = glm::ortho(-extent, extent, -extent, extent, -(extent + CASTER_DISTANCE), extent);
+            cascade.proj_view = light_proj * light_view;
+        }
+        cascade.split = split;
+        cullers[c].begin(cascade.proj_view);
+        prev_split = split;
+    }
+}
+
+void CascadedShadowMap::bindLayer(GLuint fbo, GLuint texture, int layer) {
+    if (!in_pass) {
+        glGetIntegerv(GL_VIEWPORT, prev_viewport);
+        glGetIntegerv(GL_POLYGON_MODE, prev_polygon_mode);
+        prev_cull_face = glIsEnabled(GL_CULL_FACE);
+
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+        glViewport(0, 0, resolution, resolution);
+        in_pass = true;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+}
+
+bool CascadedShadowMap::beginStatic(int cascade) {
+    if (cascades[cascade].valid)
+        return false;
+
+    bindLayer(cache_fbo, cache_texture, cascade);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    cascades[cascade].valid = true;
+    stats.static_renders++;
+    return true;
+}
+
+void CascadedShadowMap::beginDynamic(int cascade) {
+    bindLayer(shadow_fbo, shadow_texture, cascade);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, cache_fbo);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cache_texture, 0, cascade);
+    glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow_fbo);
+    stats.dynamic_renders++;
+}
+
+void CascadedShadowMap::end() {
+    if (!in_pass)
+        return;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+    glPolygonMode(GL_FRONT_AND_BACK, prev_polygon_mode[0]);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    if (prev_cull_face)
+        glEnable(GL_CULL_FACE);
+    in_pass = false;
+}
+
+void CascadedShadowMap::bind(Shader& shader, bool enabled, GLuint unit) const {
+    static const char* matrix_names[MAX_CASCADES] = { "shadow_matrices[0]", "shadow_matrices[1]", "shadow_matrices[2]", "shadow_matrices[3]" };
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadow_texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.use();
+    shader.setInt("shadow_map", unit);
+    shader.setInt("shadow_cascades", enabled ? nr_cascades : 0);
+    if (!enabled)
+        return;
+
+    // Lighting runs in view space, so the matrices start from there
+    glm::vec4 splits(FLT_MAX), offsets(0.0f);
+    for (int c = 0; c < nr_cascades; c++) {
+        shader.setMat4(matrix_names[c], cascades[c].proj_view * inverse_view);
+        splits[c] = cascades[c].split;
+        // Normal offset of 1.5 texels against acne on surfaces facing away from the light
+        offsets[c] = 3.0f * cascades[c].extent / resolution;
+    }
+    shader.setVec4("shadow_splits", splits);
+    shader.setVec4("shadow_offsets", offsets);
+    shader.setFloat("shadow_texel", 1.0f / resolution);
+}
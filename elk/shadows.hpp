@@ -0,0 +1,100 @@
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "culling.hpp"
+#include "shader.hpp"
+
+const int MAX_CASCADES = 4;
+
+struct ShadowStats {
+    unsigned int static_renders = 0;
+    unsigned int dynamic_renders = 0;
+};
+
+// Cascaded shadow maps for a directional light. Each cascade is a padded, texel-snapped orthographic box around
+// its slice of the view frustum that only moves once the slice leaves the padding, so static casters are kept in
+// a cache layer and re-rendered only when their cascade moves or the light turns past update_threshold degrees.
+// Dynamic casters are drawn every frame on top of a copy of the cache.
+class CascadedShadowMap {
+public:
+    float max_distance;
+    float split_lambda;
+    float update_threshold;
+
+    CascadedShadowMap(int nr_cascades = 4, int resolution = 2048, float max_distance = 50.0f);
+    ~CascadedShadowMap();
+
+    // Reallocates the maps if the configuration changed
+    void configure(int nr_cascades, int resolution);
+
+    // Forces static casters to be re-rendered, e.g. after they changed
+    void invalidate();
+
+    // Fits the cascades to the camera and begins their cullers
+    void update(const glm::mat4& view, float fov_y, float aspect, float z_near, const glm::vec3& light_dir);
+
+    // Binds the static cache layer of a cascade, returns false if it is still valid and nothing needs drawing
+    bool beginStatic(int cascade);
+    // Copies the cache into the shadow map layer and binds it for dynamic casters
+    void beginDynamic(int cascade);
+    void end();
+
+    // Sets the shadow uniforms of a lighting program, disabled maps still bind a valid sampler
+    void bind(Shader& shader, bool enabled = true, GLuint unit = 8) const;
+
+    // Light projection * view of a cascade, for caster programs
+    const glm::mat4& getLightMatrix(int cascade) const {
+        return cascades[cascade].proj_view;
+    }
+
+    FrustumCuller& getCuller(int cascade) {
+        return cullers[cascade];
+    }
+
+    int getCascadeCount() const {
+        return nr_cascades;
+    }
+
+    int getResolution() const {
+        return resolution;
+    }
+
+    const ShadowStats& getStats() const {
+        return stats;
+    }
+
+private:
+    struct Cascade {
+        glm::vec3 center = glm::vec3(0.0f);
+        float extent = 0.0f;
+        float split = 0.0f;
+        glm::mat4 proj_view = glm::mat4(1.0f);
+        bool valid = false;
+    };
+
+    int nr_cascades, resolution;
+    Cascade cascades[MAX_CASCADES];
+    std::vector<FrustumCuller> cullers;
+
+    glm::vec3 light_dir = glm::vec3(0.0f);
+    glm::mat4 light_rotation = glm::mat4(1.0f);
+    glm::mat4 inverse_view = glm::mat4(1.0f);
+
+    GLuint cache_texture = 0, shadow_texture = 0;
+    GLuint cache_fbo, shadow_fbo;
+    GLint prev_viewport[4];
+    GLint prev_polygon_mode[2];
+    GLboolean prev_cull_face;
+    bool in_pass = false;
+    ShadowStats stats;
+
+    void allocate();
+    void bindLayer(GLuint fbo, GLuint texture, int layer);
+};
+
+#endif // !SHADOWS_H
@@ -0,0 +1,79 @@
+#include "simulation.hpp"
+
+#include <chrono>
+
+Simulation::Simulation(const SceneSnapshot& initial, const SimulationInput& input, const std::vector<glm::vec3>& cluster_orbits, float tick_rate) :
+    orbits(cluster_orbits),
+    tick_rate(tick_rate),
+    inputs(input),
+    snapshots(initial)
+{
+    thread = std::thread(&Simulation::loop, this, initial);
+}
+
+Simulation::~Simulation() {
+    running = false;
+    thread.join();
+}
+
+void Simulation::setInput(const SimulationInput& input) {
+    inputs.getWriteSlot() = input;
+    inputs.publish();
+}
+
+const SceneSnapshot& Simulation::getLatest() {
+    return snapshots.getLatest();
+}
+
+void Simulation::loop(SceneSnapshot state) {
+    using clock = std::chrono::steady_clock;
+    const clock::duration period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / tick_rate));
+    const float dt = 1.0f / tick_rate;
+
+    bool captured = false;
+    double last_scroll = inputs.getLatest().scroll;
+    clock::time_point next = clock::now();
+
+    while (running.load(std::memory_order_relaxed)) {
+        const SimulationInput& input = inputs.getLatest();
+
+        Camera& camera = state.camera;
+        if (input.capture) {
+            if (!captured)
+                camera.refocus = true;
+            for (int m = 0; m <= static_cast<int>(CameraMovement::DOWN); m++) {
+                if (input.movement & (1u << m))
+                    camera.processKeyboard(static_cast<CameraMovement>(m), dt);
+            }
+            camera.processMouseMovement(input.cursor_x, input.cursor_y);
+            camera.processMouseScroll(static_cast<float>(input.scroll - last_scroll));
+        }
+        captured = input.capture;
+        last_scroll = input.scroll;
+
+        state.tick++;
+        state.time = glfwGetTime();
+        float time = static_cast<float>(state.time);
+        if (input.animate_dir_light)
+            state.dir_light_dir = glm::vec4(sin(time), -1.0f, cos(time), 0.0f);
+        if (input.animate_cluster_lights) {
+            state.cluster_light_positions.resize(orbits.size());
+            for (size_t i = 0; i < orbits.size(); i++) {
+                const glm::vec3& orbit = orbits[i];
+                float angle = orbit.y + time * 2.0f / (1.0f + orbit.x);
+                state.cluster_light_positions[i] = glm::vec4(orbit.x * glm::cos(angle), orbit.z, orbit.x * glm::sin(angle), 1.0f);
+            }
+        }
+
+        // Copying into the slot reuses its storage, so ticks do not allocate once the slots are warm
+        snapshots.getWriteSlot() = state;
+        snapshots.publish();
+
+        // Ticks missed during a stall are dropped rather than caught up on
+        next += period;
+        clock::time_point now = clock::now();
+        if (next < now)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "camera.hpp"
+#include "triple_buffer.hpp"
+
+// Input sampled by the main thread, GLFW only allows polling there
+struct SimulationInput {
+    // Bit per CameraMovement held down
+    unsigned int movement = 0;
+    // Totals since startup, the simulation applies the change since its previous tick so none is lost
+    double cursor_x = 0.0, cursor_y = 0.0, scroll = 0.0;
+    bool capture = false;
+    bool animate_dir_light = true;
+    bool animate_cluster_lights = true;
+};
+
+// Immutable scene state of one simulation tick
+struct SceneSnapshot {
+    uint64_t tick = 0;
+    // glfwGetTime of the tick
+    double time = 0.0;
+    Camera camera;
+    glm::vec4 dir_light_dir = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+    std::vector<glm::vec4> cluster_light_positions;
+};
+
+// Advances the camera and the light animation on its own thread at a fixed tick rate, so simulating the next frame
+// overlaps rendering the current one. Input goes in and snapshots come out through triple buffers, the render
+// thread always gets the latest finished tick without waiting on the simulation.
+class Simulation {
+public:
+    // Input seeds the cursor and scroll totals the first tick measures from
+    Simulation(const SceneSnapshot& initial, const SimulationInput& input, const std::vector<glm::vec3>& cluster_orbits, float tick_rate = 120.0f);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    // Main thread
+    void setInput(const SimulationInput& input);
+
+    // Render thread, the snapshot stays valid and unchanged until the next call
+    const SceneSnapshot& getLatest();
+
+    size_t getOrbitCount() const {
+        return orbits.size();
+    }
+
+    float getTickRate() const {
+        return tick_rate;
+    }
+
+private:
+    const std::vector<glm::vec3> orbits;
+    const float tick_rate;
+
+    TripleBuffer<SimulationInput> inputs;
+    TripleBuffer<SceneSnapshot> snapshots;
+
+    std::atomic<bool> running = true;
+    std::thread thread;
+
+    void loop(SceneSnapshot state);
+};
+
+#endif // !SIMULATION_H
@@ -0,0 +1,112 @@
+#include "stream_buffer.hpp"
+
+#include <chrono>
+#include <iostream>
+
+StreamBuffer::StreamBuffer(GLsizeiptr frame_size, bool allow_persistent) :
+    frame_size(frame_size),
+    persistent(allow_persistent && glBufferStorage)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniform_alignment = alignment;
+
+    // The copy target leaves the array and element bindings of the current VAO alone
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, FRAMES * frame_size, NULL, flags);
+        mapping = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, FRAMES * frame_size, flags));
+        if (!mapping) {
+            std::cout << "ERROR::STREAM_BUFFER:: Persistent mapping failed, orphaning instead" << std::endl;
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            persistent = false;
+        }
+    }
+    if (!persistent)
+        glBufferData(GL_COPY_WRITE_BUFFER, frame_size, NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    if (mapping) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &buffer);
+}
+
+void StreamBuffer::beginFrame() {
+    cursor = 0;
+    frame_stats = StreamStats();
+
+    if (persistent) {
+        // Normally long done, the region was last used FRAMES - 1 frames ago
+        GLsync& fence = fences[region];
+        if (fence) {
+            auto start = std::chrono::high_resolution_clock::now();
+            GLenum result = glClientWaitSync(fence, 0, 0);
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            frame_stats.wait_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+    else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, frame_size, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+}
+
+void StreamBuffer::endFrame() {
+    if (persistent) {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % FRAMES;
+    }
+    frame_stats.bytes = cursor;
+    stats = frame_stats;
+}
+
+StreamRange StreamBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+    StreamRange range;
+    GLsizeiptr offset = (cursor + alignment - 1) / alignment * alignment;
+    if (offset + size > frame_size) {
+        frame_stats.overflows++;
+        return range;
+    }
+    cursor = offset + size;
+    frame_stats.allocations++;
+
+    range.size = size;
+    if (persistent) {
+        range.offset = region * frame_size + offset;
+        range.data = mapping + range.offset;
+    }
+    else {
+        range.offset = offset;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        range.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return range;
+}
+
+void StreamBuffer::commit(const StreamRange& range) {
+    // Coherent writes become visible to commands issued after them
+    if (persistent || !range.data)
+        return;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
@@ -0,0 +1,93 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// Part of the stream buffer the CPU writes this frame's data into
+struct StreamRange {
+    // Null when the frame's region is full
+    void* data = nullptr;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+};
+
+struct StreamStats {
+    // Used by the last finished frame
+    GLsizeiptr bytes = 0;
+    unsigned int allocations = 0;
+    unsigned int overflows = 0;
+    // Time spent waiting on the GPU to release a region
+    float wait_ms = 0.0f;
+};
+
+// Per-frame data written straight into GL memory. With buffer storage (GL 4.4) the buffer holds FRAMES regions that
+// stay coherently mapped, the frame's region is fenced when the frame ends and only waited on when it comes around
+// again. Without it the buffer is orphaned every frame and each allocation is mapped unsynchronized, the driver
+// hands out fresh memory while the GPU still reads the old one. Either way ranges are bound with glBindBufferRange
+// or as vertex attribute offsets, and the buffer can back any target.
+class StreamBuffer {
+public:
+    static const int FRAMES = 3;
+
+    StreamBuffer(GLsizeiptr frame_size, bool allow_persistent = true);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    void beginFrame();
+    void endFrame();
+
+    // Commit a range before allocating the next one, the fallback can only map one at a time
+    StreamRange allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+    void commit(const StreamRange& range);
+
+    template <typename T>
+    StreamRange write(const T& value, GLsizeiptr alignment = 16) {
+        StreamRange range = allocate(sizeof(T), alignment);
+        if (range.data) {
+            std::memcpy(range.data, &value, sizeof(T));
+            commit(range);
+        }
+        return range;
+    }
+
+    void bindRange(GLenum target, GLuint index, const StreamRange& range) const {
+        glBindBufferRange(target, index, buffer, range.offset, range.size);
+    }
+
+    GLuint getBuffer() const {
+        return buffer;
+    }
+
+    bool isPersistent() const {
+        return persistent;
+    }
+
+    // Offset alignment uniform block ranges need
+    GLsizeiptr getUniformAlignment() const {
+        return uniform_alignment;
+    }
+
+    const StreamStats& getStats() const {
+        return stats;
+    }
+
+private:
+    GLuint buffer;
+    GLsizeiptr frame_size;
+    GLsizeiptr uniform_alignment;
+    bool persistent;
+
+    // Persistent mapping of all regions
+    char* mapping = nullptr;
+    GLsync fences[FRAMES] = {};
+    int region = 0;
+
+    GLsizeiptr cursor = 0;
+    StreamStats stats, frame_stats;
+};
+
+#endif // !STREAM_BUFFER_H
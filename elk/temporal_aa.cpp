@@ -0,0 +1,146 @@
+#include "temporal_aa.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    float halton(unsigned int index, unsigned int base) {
+        float f = 1.0f, result = 0.0f;
+        while (index > 0) {
+            f /= base;
+            result += f * (index % base);
+            index /= base;
+        }
+        return result;
+    }
+}
+
+TemporalAA::TemporalAA() :
+    velocity_shader("shaders/taa_velocity.vert", "shaders/taa_velocity.frag"),
+    resolve_shader("shaders/deferred.vert", "shaders/taa_resolve.frag")
+{
+    glGenVertexArrays(1, &empty_vao);
+}
+
+TemporalAA::~TemporalAA() {
+    glDeleteTextures(2, history);
+    glDeleteVertexArrays(1, &empty_vao);
+}
+
+glm::mat4 TemporalAA::jitter(const glm::mat4& proj, const glm::uvec2& render_size, const glm::uvec2& output_size) {
+    // Eight offsets cover a pixel well at full resolution, each output pixel needs as many of its own samples
+    float ratio = static_cast<float>(output_size.x * output_size.y) / (render_size.x * render_size.y);
+    unsigned int phases = std::max(8u, static_cast<unsigned int>(std::ceil(8.0f * ratio)));
+
+    frame_index++;
+    unsigned int i = frame_index % phases + 1;
+    jitter_offset = glm::vec2(halton(i, 2), halton(i, 3)) - 0.5f;
+
+    glm::vec2 ndc_offset = 2.0f * jitter_offset / glm::vec2(render_size);
+    return glm::translate(glm::mat4(1.0f), glm::vec3(ndc_offset, 0.0f)) * proj;
+}
+
+void TemporalAA::setModel(const glm::mat4& model, const glm::mat4& prev_model) {
+    velocity_shader.setMat4("model", model);
+    velocity_shader.setMat4("prev_model", prev_model);
+}
+
+void TemporalAA::resizeHistory(FrameGraph& graph, const glm::uvec2& size) {
+    for (GLuint& texture : history) {
+        if (texture) {
+            graph.forgetTexture(texture);
+            glDeleteTextures(1, &texture);
+        }
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size.x, size.y, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    history_desc = { size.x, size.y, GL_RGBA16F };
+    history_valid = false;
+}
+
+FrameResource TemporalAA::addPasses(
+    FrameGraph& graph,
+    FrameResource color,
+    FrameResource depth_stencil,
+    const glm::uvec2& output_size,
+    const glm::mat4& jittered_proj,
+    const glm::mat4& proj,
+    const glm::mat4& view,
+    const std::function<void(Shader&)>& draw_velocity
+) {
+    if (output_size != glm::uvec2(history_desc.width, history_desc.height))
+        resizeHistory(graph, output_size);
+
+    glm::mat4 view_proj = proj * view;
+    TextureDesc velocity_desc = graph.getDesc(color);
+    velocity_desc.format = GL_RG16F;
+
+    FrameResource velocity = graph.create("Velocity", velocity_desc);
+    graph.addPass("TAA velocity", [this, jittered_proj, view, view_proj, prev_view_proj = prev_view_proj, draw_velocity](FrameGraph&) {
+        // Pixels nothing is drawn to are marked for a camera-only reprojection in the resolve
+        GLfloat no_velocity[] = { -2.0f, -2.0f, 0.0f, 0.0f };
+        glClearBufferfv(GL_COLOR, 0, no_velocity);
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+        glStencilMask(0x00);
+
+        velocity_shader.use();
+        velocity_shader.setMat4("proj", jittered_proj);
+        velocity_shader.setMat4("view", view);
+        velocity_shader.setMat4("view_proj", view_proj);
+        velocity_shader.setMat4("prev_view_proj", prev_view_proj);
+        velocity_shader.setBool("alpha_test", false);
+        draw_velocity(velocity_shader);
+
+        glStencilMask(0xFF);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }).write(velocity).depthStencil(depth_stencil, false);
+
+    FrameResource prev_history = graph.importTexture("TAA history", history[current], history_desc);
+    FrameResource next_history = graph.importTexture("TAA history", history[1 - current], history_desc);
+    glm::mat4 reproject = prev_view_proj * glm::inverse(view_proj);
+    graph.addPass("TAA resolve", [this, color, depth_stencil, velocity, prev_history, reproject, jitter = jitter_offset, valid = history_valid](FrameGraph& graph) {
+        GLint polygon_mode[2];
+        glGetIntegerv(GL_POLYGON_MODE, polygon_mode);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_STENCIL_TEST);
+        glBindVertexArray(empty_vao);
+
+        resolve_shader.use();
+        resolve_shader.setVec2("jitter", jitter);
+        resolve_shader.setMat4("reproject", reproject);
+        resolve_shader.setFloat("feedback", feedback);
+        resolve_shader.setBool("history_valid", valid);
+
+        const char* samplers[] = { "scene_color", "scene_depth", "velocity", "history" };
+        FrameResource inputs[] = { color, depth_stencil, velocity, prev_history };
+        for (int i = 0; i < 4; i++) {
+            resolve_shader.setInt(samplers[i], i);
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, graph.getTexture(inputs[i]));
+        }
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindVertexArray(0);
+        glEnable(GL_STENCIL_TEST);
+        glEnable(GL_DEPTH_TEST);
+        glPolygonMode(GL_FRONT_AND_BACK, polygon_mode[0]);
+    }).read(color).read(depth_stencil).read(velocity).read(prev_history).write(next_history);
+
+    current = 1 - current;
+    history_valid = true;
+    prev_view_proj = view_proj;
+    return next_history;
+}
@@ -0,0 +1,63 @@
+#ifndef TEMPORAL_AA_H
+#define TEMPORAL_AA_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <functional>
+
+#include "frame_graph.hpp"
+#include "shader.hpp"
+
+// Temporal anti-aliasing. Every frame renders with the projection shifted by a sub-pixel Halton offset, a velocity
+// pass stores how far each pixel moved since the previous frame and the resolve reprojects the accumulated
+// history with it, clamps it to the colors around the new sample and blends the two. The history is kept at
+// output resolution, so rendering below it reconstructs the full resolution over a number of frames.
+class TemporalAA {
+public:
+    // Share of the history kept each frame
+    float feedback = 0.9f;
+
+    TemporalAA();
+    ~TemporalAA();
+
+    // Jitters proj by this frame's offset, the sequence is longer the fewer render pixels cover an output pixel
+    glm::mat4 jitter(const glm::mat4& proj, const glm::uvec2& render_size, const glm::uvec2& output_size);
+
+    // Uploads the model matrices of a draw into the velocity program
+    void setModel(const glm::mat4& model, const glm::mat4& prev_model);
+
+    // Adds the velocity and resolve passes and returns the anti-aliased color at output_size. draw_velocity draws
+    // the scene with the given program, which is depth tested against the scene depth.
+    FrameResource addPasses(
+        FrameGraph& graph,
+        FrameResource color,
+        FrameResource depth_stencil,
+        const glm::uvec2& output_size,
+        const glm::mat4& jittered_proj,
+        const glm::mat4& proj,
+        const glm::mat4& view,
+        const std::function<void(Shader&)>& draw_velocity
+    );
+
+    // Drops the history, e.g. when the effect was off for a while
+    void reset() {
+        history_valid = false;
+    }
+
+private:
+    Shader velocity_shader, resolve_shader;
+    GLuint empty_vao;
+    GLuint history[2] = { 0, 0 };
+    TextureDesc history_desc;
+    int current = 0;
+    bool history_valid = false;
+
+    unsigned int frame_index = 0;
+    glm::vec2 jitter_offset = glm::vec2(0.0f);
+    glm::mat4 prev_view_proj = glm::mat4(1.0f);
+
+    void resizeHistory(FrameGraph& graph, const glm::uvec2& size);
+};
+
+#endif // !TEMPORAL_AA_H
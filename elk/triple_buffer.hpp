@@ -0,0 +1,41 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Single producer, single consumer hand-off of the latest value without locks. The writer fills its own slot and
+// swaps it with the shared middle slot, the reader swaps its slot with the middle one only when that holds a value
+// it has not seen. Neither side ever waits, values the reader is too slow for are overwritten.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer(const T& initial = T()) :
+        slots{ initial, initial, initial }
+    { }
+
+    // Writer side, fill the slot and publish it
+    T& getWriteSlot() {
+        return slots[back];
+    }
+
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader side, the returned value stays unchanged until the next call
+    const T& getLatest() {
+        if (middle.load(std::memory_order_relaxed) & FRESH)
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        return slots[front];
+    }
+
+private:
+    static const uint8_t INDEX = 3, FRESH = 4;
+
+    T slots[3];
+    uint8_t back = 0, front = 1;
+    std::atomic<uint8_t> middle = 2;
+};
+
+#endif // !TRIPLE_BUFFER_H
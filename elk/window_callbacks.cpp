@@ -22,6 +22,9 @@ namespace controller {
     void updateMeshIndex(int index) {
         window_state.mesh = index;
     }
+    void setCamera(Camera* camera) {
+        window_state.camera = camera;
+    }
     void processInput(GLFWwindow* window, Bindings* bindings, float dt) {
         if (bindings->key_esc.clicked()) {
             if (!window_state.capture_controller) {
@@ -34,12 +37,13 @@ namespace controller {
         if (!window_state.capture_controller && bindings->mouse_left.clicked()) {
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
             glfwSetScrollCallback(window, scrollCallback);
-            window_state.camera->refocus = true;
+            if (window_state.camera)
+                window_state.camera->refocus = true;
             window_state.capture_controller = true;
         }
         // TODO Change to more efficient callbacks
         // TODO Add better controls for modified keys.
-        if (window_state.capture_controller) {
+        if (window_state.capture_controller && window_state.camera) {
             if (bindings->key_w.down())
                 window_state.camera->processKeyboard(CameraMovement::FORWARD, dt);
             if (bindings->key_s.down())
@@ -52,6 +56,9 @@ namespace controller {
                 window_state.camera->processKeyboard(CameraMovement::UP, dt);
             if (bindings->key_lctrl.down())
                 window_state.camera->processKeyboard(CameraMovement::DOWN, dt);
+            window_state.camera->processMouseMovement(window);
+        }
+        if (window_state.capture_controller) {
             if (bindings->key_up.down() && bindings->key_lalt.down())
                 window_state.distance += 5.0f;
             if (bindings->key_down.down() && bindings->key_lalt.down())
@@ -68,7 +75,6 @@ namespace controller {
                 }
                 window_state.depth_testing = !window_state.depth_testing;
             }
-            window_state.camera->processMouseMovement(window);
         }
     }
 }
@@ -81,14 +87,24 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
 }
 
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
-    window_state.camera->processMouseScroll(static_cast<float>(yoffset));
+    window_state.scroll += yoffset;
+    if (window_state.camera)
+        window_state.camera->processMouseScroll(static_cast<float>(yoffset));
 }
 
 GLFWwindow* bindWindow(unsigned int scr_width, unsigned int scr_height, Camera* camera, const std::string& title) {
     window_state.scr_width = scr_width;
     window_state.scr_height = scr_height;
 
-    GLFWwindow* window = glfwCreateWindow(window_state.scr_width, window_state.scr_height, title.c_str(), NULL, NULL);
+    // The newest context enables the indirect paths, everything else only needs 3.3
+    GLFWwindow* window = NULL;
+    for (int version : { 46, 43, 33 }) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version / 10);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version % 10);
+        window = glfwCreateWindow(window_state.scr_width, window_state.scr_height, title.c_str(), NULL, NULL);
+        if (window)
+            break;
+    }
     {
         if (window == NULL)
         {
@@ -14,6 +14,8 @@ struct WindowState {
     unsigned int scr_width = 800;
     unsigned int scr_height = 600;
     float distance = 10.0f;
+    // Scrolled since startup
+    double scroll = 0.0;
     int mesh = -1;
     bool capture_controller = true,
         depth_testing = true,
@@ -24,6 +26,8 @@ struct WindowState {
 namespace controller {
     WindowState getState();
     void updateMeshIndex(int index);
+    // Null leaves the camera to another thread, input then only updates the window state
+    void setCamera(Camera* camera);
     void processInput(GLFWwindow* window, Bindings* bindings, float dt);
 }
 